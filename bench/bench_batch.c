@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "bench_util.h"
+#include "game_batch.h"
+#include "cga_random.h"
+
+#define DEFAULT_LANES 4096
+#define DEFAULT_STEPS 20000
+
+// Usage: bench_batch [lanes] [steps] [threads]
+// Plays random moves in every lane, restarting games as soon as they're lost
+int main(int argc, char** argv) {
+  int lanes = benchArgInt(argc, argv, 1, DEFAULT_LANES);
+  int steps = benchArgInt(argc, argv, 2, DEFAULT_STEPS);
+  int threads = benchArgInt(argc, argv, 3, 1);
+
+  cgaJobsInit(threads);
+
+  game_batch batch = gameBatchCreate(lanes, 0xC6A2048ULL);
+  uint8_t* moves = malloc(lanes);
+  uint64_t* randoms = malloc(sizeof(uint64_t) * lanes);
+
+  if (batch == NULL || moves == NULL || randoms == NULL) {
+    printf("[ERROR] Failed to allocate batch of %i games\n", lanes);
+    return 1;
+  }
+
+  random_t moveRng;
+  cgaRandomSeed(&moveRng, 0x9E3779B97F4A7C15ULL);
+
+  uint64_t movesApplied = 0;
+  uint64_t gamesFinished = 0;
+  int64_t scoreSum = 0;
+
+  double start = benchNow();
+
+  for (int s = 0; s < steps; s++) {
+    cgaRandomFill(&moveRng, randoms, lanes);
+
+    for (int i = 0; i < lanes; i++) {
+      moves[i] = (uint8_t) (randoms[i] >> 62);
+    }
+
+    gameBatchStep(batch, moves);
+
+    for (int i = 0; i < lanes; i++) {
+      movesApplied += batch->spawnedCells[i] != NO_SPAWN;
+
+      if (batch->lost[i]) {
+        gamesFinished++;
+        scoreSum += batch->scores[i];
+        gameBatchResetGame(batch, i);
+      }
+    }
+  }
+
+  double elapsed = benchNow() - start;
+  double steppedMoves = (double) lanes * steps;
+
+  printf("lanes=%i steps=%i threads=%i time=%.3fs\n", lanes, steps, cgaJobsWorkerCount(), elapsed);
+  printf("moves/sec:  %.0f (%.0f effective)\n", steppedMoves / elapsed, movesApplied / elapsed);
+  printf("games/sec:  %.0f finished, %llu total, avg score %.1f\n",
+    gamesFinished / elapsed,
+    (unsigned long long) gamesFinished,
+    gamesFinished > 0 ? scoreSum / (double) gamesFinished : 0.0
+  );
+
+  free(moves);
+  free(randoms);
+  gameBatchFree(batch);
+  cgaJobsShutdown();
+  return 0;
+}
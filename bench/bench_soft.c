@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "bench_util.h"
+#include "cga_soft.h"
+
+#define DEFAULT_FRAMES 2000
+#define DEFAULT_BAND_ROWS 32
+#define FRAME_SIZE 800
+
+static const char* fillNames[] = {"scalar", "sse2", "avx2"};
+
+static const uint8_t tileColors[][3] = {
+  {128, 128, 128}, {238, 228, 218}, {237, 224, 200}, {242, 177, 121},
+  {245, 149, 99}, {246, 124, 95}, {246, 94, 59}, {237, 207, 114}
+};
+
+static const char* tileLabels[] = {"", "2", "4", "8", "16", "32", "64", "128"};
+
+// Roughly the 2048 board gameMain draws: 16 tiles with labels, title and score
+static void drawFrame(soft_target target, int frame) {
+  char score[32];
+
+  cgaSoftClear(target, 0, 0, 0);
+
+  for (int i = 0; i < 16; i++) {
+    int exponent = (i + frame) % 8;
+    float x = -0.5f + (i % 4) * 0.25f;
+    float y = 0.5f - (i / 4) * 0.25f;
+
+    cgaSoftSetColor3ub(target, tileColors[exponent][0], tileColors[exponent][1], tileColors[exponent][2]);
+    cgaSoftQuad(target, x, y, x + 0.225f, y - 0.225f);
+
+    cgaSoftSetColor3ub(target, 119, 110, 101);
+    cgaSoftSetTextScale(target, 2, 2);
+    cgaSoftText(target, x + 0.02f, y - 0.05f, 8, tileLabels[exponent]);
+  }
+
+  cgaSoftSetColor3ub(target, 0, 255, 0);
+  cgaSoftSetTextScale(target, 3, 3);
+  cgaSoftText(target, -0.25f, 0.8f, 8, "2048");
+
+  snprintf(score, sizeof(score), "Score: %i", frame * 4);
+  cgaSoftText(target, -0.95f, -0.85f, sizeof(score), score);
+
+  cgaSoftFlush(target);
+}
+
+static void run(soft_target target, const char* name, int frames) {
+  target->pixelsFilled = 0;
+
+  double start = benchNow();
+
+  for (int f = 0; f < frames; f++) {
+    drawFrame(target, f);
+  }
+
+  double elapsed = benchNow() - start;
+
+  printf("%-16s %8.1f fps  %9.1f Mpix/s  %6.1f Mpix/frame\n",
+    name, frames / elapsed, target->pixelsFilled / elapsed / 1e6, target->pixelsFilled / 1e6 / frames
+  );
+}
+
+// Usage: bench_soft [frames] [threads] [bandRows]
+// Rasterises an 800x800 board frame with each span fill, then banded across threads
+int main(int argc, char** argv) {
+  int frames = benchArgInt(argc, argv, 1, DEFAULT_FRAMES);
+  int threads = benchArgInt(argc, argv, 2, 4);
+  int bandRows = benchArgInt(argc, argv, 3, DEFAULT_BAND_ROWS);
+
+  soft_target target = cgaSoftCreate(FRAME_SIZE, FRAME_SIZE);
+
+  if (target == NULL) {
+    printf("[ERROR] Failed to allocate %ix%i framebuffer\n", FRAME_SIZE, FRAME_SIZE);
+    return 1;
+  }
+
+  for (soft_fill_t fill = SOFT_FILL_SCALAR; fill <= SOFT_FILL_AVX2; fill++) {
+    cgaSoftSetFill(target, fill);
+
+    if (target->fill != fill) {
+      printf("%-16s unsupported\n", fillNames[fill]);
+      continue;
+    }
+
+    run(target, fillNames[fill], frames);
+  }
+
+  char name[32];
+  cgaJobsInit(threads);
+
+  cgaSoftSetFill(target, cgaSoftBestFill());
+  cgaSoftSetBandRows(target, bandRows);
+  snprintf(name, sizeof(name), "%s x%i", fillNames[target->fill], cgaJobsWorkerCount());
+  run(target, name, frames);
+
+  cgaJobsShutdown();
+  cgaSoftFree(target);
+
+  return 0;
+}
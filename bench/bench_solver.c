@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_util.h"
+#include "game_rules.h"
+#include "game_solver.h"
+
+#define DEFAULT_MAX_DEPTH 4
+#define DEFAULT_MOVES 200
+
+// Usage: bench_solver [maxDepth] [movesPerDepth] [threads]
+// Plays a seeded game with the solver at every depth and reports search
+// throughput and transposition table hit rate
+int main(int argc, char** argv) {
+  int maxDepth = benchArgInt(argc, argv, 1, DEFAULT_MAX_DEPTH);
+  int moveLimit = benchArgInt(argc, argv, 2, DEFAULT_MOVES);
+  int threads = benchArgInt(argc, argv, 3, 1);
+
+  cgaJobsInit(threads);
+  printf("threads=%i\n", cgaJobsWorkerCount());
+
+  solver s = solverCreate(SOLVER_DEFAULT_TABLE_MB);
+  game_context game = gameCreate();
+
+  if (s == NULL || game == NULL) {
+    printf("[ERROR] Failed to allocate solver\n");
+    return 1;
+  }
+
+  printf("depth      moves      score      nodes/sec    tt hit rate\n");
+
+  for (int depth = 1; depth <= maxDepth; depth++) {
+    gameResetSeeded(game, 2048);
+    solverClearTable(s);
+
+    uint64_t nodes = 0;
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    double elapsed = 0;
+    int moves = 0;
+
+    while (!gameIsLost(game) && moves < moveLimit) {
+      solver_stats_t stats;
+      int move = solverBestMove(s, gameGetBoard(game), depth, NULL, &stats);
+
+      if (move == SOLVER_NO_MOVE) {
+        break;
+      }
+
+      gameMove(game, (shift_direction_t) move);
+
+      nodes += stats.nodes;
+      lookups += stats.ttLookups;
+      hits += stats.ttHits;
+      elapsed += stats.elapsedSecs;
+      moves++;
+    }
+
+    printf("%5i %10i %10i %14.0f %13.1f%%\n",
+      depth,
+      moves,
+      gameGetScore(game),
+      elapsed > 0 ? nodes / elapsed : 0.0,
+      lookups > 0 ? 100.0 * hits / lookups : 0.0
+    );
+  }
+
+  gameFree(game);
+  solverFree(s);
+  cgaJobsShutdown();
+  return 0;
+}
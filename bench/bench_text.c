@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <GL/glew.h>
+
+#include "bench_util.h"
+#include "cga_window.h"
+#include "cga_batch.h"
+#include "font_draw.h"
+
+#define DEFAULT_FRAMES 300
+#define TEXT_LINES 40
+#define LINE_LEN 64
+
+typedef struct {
+  const char* name;
+  text_draw_mode_t mode;
+  double totalTime;
+  int frames;
+  batch_stats_t stats;
+} text_phase_t;
+
+static text_phase_t phases[] = {
+  {.name = "per-pixel quads", .mode = TEXT_MODE_PIXELS},
+  {.name = "glyph atlas", .mode = TEXT_MODE_ATLAS}
+};
+
+static char lines[TEXT_LINES][LINE_LEN];
+static int framesPerPhase = DEFAULT_FRAMES;
+static int frame = 0;
+static double lastFrameStart = 0;
+
+static void onFrame(float deltaTime, float ratio) {
+  double now = benchNow();
+  int phase = frame / framesPerPhase;
+  int prevPhase = (frame - 1) / framesPerPhase;
+
+  // Time of the previous frame, including its flush and swap
+  if (frame > 0 && (frame % framesPerPhase) != 0) {
+    phases[prevPhase].totalTime += now - lastFrameStart;
+    phases[prevPhase].frames++;
+  }
+
+  if (frame > 0 && (frame % framesPerPhase) == 0) {
+    cgaBatchGetStats(&phases[prevPhase].stats);
+  }
+
+  if (phase >= 2) {
+    cgaSetShouldClose(true);
+    return;
+  }
+
+  cgaSetTextDrawMode(phases[phase].mode);
+  cgaSetTextScale(0.7f, 0.7f);
+  cgaBatchSetColor3f(1.0f, 1.0f, 1.0f);
+
+  for (int i = 0; i < TEXT_LINES; i++) {
+    cgaDrawText(-1.0f, 1.0f - i * 0.05f, LINE_LEN, lines[i]);
+  }
+
+  // Make the frame time include the GPU work
+  glFinish();
+
+  lastFrameStart = now;
+  frame++;
+}
+
+// Usage: bench_text [frames per mode]
+// Draws a screen full of text with both text paths and compares frame times
+int main(int argc, char** argv) {
+  framesPerPhase = benchArgInt(argc, argv, 1, DEFAULT_FRAMES);
+
+  for (int i = 0; i < TEXT_LINES; i++) {
+    snprintf(lines[i], LINE_LEN, "%02i The quick brown fox jumps over the lazy dog 0123456789", i);
+  }
+
+  if (!cgaInit()) {
+    return 1;
+  }
+
+  cgaSetVsync(false);
+  cgaSetScreenSize(800, 800);
+  cgaInitTextDraw();
+  cgaSetFrameCallback(onFrame);
+
+  cgaLoop();
+
+  cgaCloseTextDraw();
+  cgaClose();
+
+  for (int i = 0; i < 2; i++) {
+    text_phase_t* p = &phases[i];
+    double avg = p->frames > 0 ? p->totalTime / p->frames : 0;
+
+    printf("%-16s avg frame %.3fms  quads/frame %i  draw calls/frame %i\n",
+      p->name, avg * 1000.0, p->stats.quads, p->stats.drawCalls
+    );
+  }
+
+  return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stdlib.h>
+#include <time.h>
+
+static inline double benchNow() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline int benchArgInt(int argc, char** argv, int index, int fallback) {
+  if (argc <= index) {
+    return fallback;
+  }
+
+  int v = atoi(argv[index]);
+  return v > 0 ? v : fallback;
+}
+
+#endif // BENCH_UTIL_H
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "bench_util.h"
+#include "cga_vertex.h"
+
+#define DEFAULT_VERTICES 1000000
+#define DEFAULT_RUNS 5
+#define LEGACY_GROW_STEP 1024
+
+typedef struct {
+  float x;
+  float y;
+  float u;
+  float v;
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint8_t a;
+} bench_vertex_t;
+
+static const vertex_layout_t benchLayout = {
+  .stride = sizeof(bench_vertex_t),
+  .attribCount = 3,
+  .attribs = {
+    VERTEX_ATTRIB(ATTRIB_POSITION, ATTRIB_F32, 2, bench_vertex_t, x),
+    VERTEX_ATTRIB(ATTRIB_TEXCOORD, ATTRIB_F32, 2, bench_vertex_t, u),
+    VERTEX_ATTRIB(ATTRIB_COLOR, ATTRIB_U8, 4, bench_vertex_t, r)
+  }
+};
+
+// The growth cgaPush* used before, capacity rounded up to the next 1 KiB
+static void legacyPush(vertex_buffer buf, const void* src, uint32_t size) {
+  uint32_t nlen = buf->length + size;
+
+  if (nlen > buf->capacity) {
+    uint32_t ncap = ((nlen / LEGACY_GROW_STEP) + 1) * LEGACY_GROW_STEP;
+    uint8_t* nptr = realloc(buf->data, ncap);
+
+    if (nptr == NULL) {
+      return;
+    }
+
+    buf->data = nptr;
+    buf->capacity = ncap;
+  }
+
+  for (uint32_t i = 0; i < size; i++) {
+    buf->data[buf->length + i] = ((const uint8_t*) src)[i];
+  }
+
+  buf->length = nlen;
+}
+
+static void fillLegacy(vertex_buffer buf, int count) {
+  for (int i = 0; i < count; i++) {
+    // Same sequence of pushes as fillPush
+    float pos[2] = {(float) i, (float) -i};
+    float uv[2] = {0.5f, 0.25f};
+    uint8_t rgba[4] = {255, (uint8_t) i, 0, 255};
+
+    legacyPush(buf, pos, sizeof(pos));
+    legacyPush(buf, uv, sizeof(uv));
+
+    for (int c = 0; c < 4; c++) {
+      legacyPush(buf, &rgba[c], 1);
+    }
+  }
+}
+
+static void fillPush(vertex_buffer buf, int count) {
+  for (int i = 0; i < count; i++) {
+    cgaPushVertex2f(buf, (float) i, (float) -i);
+    cgaPushVertex2f(buf, 0.5f, 0.25f);
+    cgaPushU8(buf, 255);
+    cgaPushU8(buf, (uint8_t) i);
+    cgaPushU8(buf, 0);
+    cgaPushU8(buf, 255);
+  }
+}
+
+static void writeVertex(bench_vertex_t* v, int i) {
+  v->x = (float) i;
+  v->y = (float) -i;
+  v->u = 0.5f;
+  v->v = 0.25f;
+  v->r = 255;
+  v->g = (uint8_t) i;
+  v->b = 0;
+  v->a = 255;
+}
+
+// One span per quad, like the batcher
+static void fillQuadSpans(vertex_buffer buf, int count) {
+  for (int i = 0; i < count; i += 6) {
+    int n = count - i < 6 ? count - i : 6;
+    bench_vertex_t* v = cgaWriteVertices(buf, &benchLayout, n);
+
+    for (int k = 0; k < n; k++) {
+      writeVertex(&v[k], i + k);
+    }
+  }
+}
+
+static void fillSingleSpan(vertex_buffer buf, int count) {
+  bench_vertex_t* v = CGA_WRITE_SPAN(buf, bench_vertex_t, count);
+
+  for (int i = 0; i < count; i++) {
+    writeVertex(&v[i], i);
+  }
+}
+
+typedef void (*fill_fn_t)(vertex_buffer buf, int count);
+
+// Fastest of `runs` fills into a fresh buffer, growth included
+static double timeFill(fill_fn_t fill, int count, int runs, uint64_t* checksum) {
+  double best = 1e30;
+
+  for (int r = 0; r < runs; r++) {
+    vertex_buffer buf = cgaAllocVertexBuffer(0);
+
+    if (buf == NULL) {
+      return 0;
+    }
+
+    double start = benchNow();
+    fill(buf, count);
+    double elapsed = benchNow() - start;
+
+    if (elapsed < best) {
+      best = elapsed;
+    }
+
+    // Keeps the writes observable and checks every path built the same data
+    uint64_t sum = buf->length;
+
+    for (uint32_t i = 0; i < buf->length; i += 4096) {
+      sum = sum * 31 + buf->data[i];
+    }
+
+    *checksum = sum;
+    cgaReleaseVertexBuffer(buf);
+  }
+
+  return best;
+}
+
+// Usage: bench_vertex [vertices] [runs]
+int main(int argc, char** argv) {
+  int count = benchArgInt(argc, argv, 1, DEFAULT_VERTICES);
+  int runs = benchArgInt(argc, argv, 2, DEFAULT_RUNS);
+
+  struct {
+    const char* name;
+    fill_fn_t fill;
+  } cases[] = {
+    {"legacy push, 1 KiB growth", fillLegacy},
+    {"push, doubling growth", fillPush},
+    {"span per quad", fillQuadSpans},
+    {"single span", fillSingleSpan}
+  };
+
+  int caseCount = sizeof(cases) / sizeof(cases[0]);
+  uint64_t reference = 0;
+
+  printf("vertices: %i x %zu bytes, best of %i\n", count, sizeof(bench_vertex_t), runs);
+
+  for (int c = 0; c < caseCount; c++) {
+    uint64_t checksum = 0;
+    double secs = timeFill(cases[c].fill, count, runs, &checksum);
+
+    if (c == 0) {
+      reference = checksum;
+    }
+
+    printf("%-28s %8.2f ms  %8.1f Mverts/s%s\n",
+      cases[c].name, secs * 1e3, count / secs / 1e6,
+      checksum == reference ? "" : "  (data mismatch)"
+    );
+  }
+
+  return 0;
+}
@@ -0,0 +1,500 @@
+#include "cga_batch.h"
+#include "cga_render.h"
+#include "cga_gl_state.h"
+#include "cga_shader.h"
+#include "log.h"
+#include <string.h>
+
+#define STREAM_RING_SIZE (4 * 1024 * 1024)
+#define BATCH_SHRINK_CLEARS 1024
+#define TO_U8(f) ((uint8_t) ((f) < 0 ? 0 : ((f) > 1 ? 255 : (f) * 255.0f)))
+
+// Core profile replacement for the GL_MODULATE texture environment, the
+// texture's red channel is the coverage the font atlas stores in alpha
+// under the fixed function path
+static const char* batchVertexShader =
+  "#version 330 core\n"
+  "layout(location = 0) in vec2 aPos;\n"
+  "layout(location = 1) in vec2 aUv;\n"
+  "layout(location = 2) in vec4 aColor;\n"
+  "out vec2 vUv;\n"
+  "out vec4 vColor;\n"
+  "void main() {\n"
+  "  vUv = aUv;\n"
+  "  vColor = aColor;\n"
+  "  gl_Position = vec4(aPos, 0.0, 1.0);\n"
+  "}\n";
+
+static const char* batchFragmentShader =
+  "#version 330 core\n"
+  "in vec2 vUv;\n"
+  "in vec4 vColor;\n"
+  "uniform sampler2D uTexture;\n"
+  "uniform bool uTextured;\n"
+  "out vec4 fragColor;\n"
+  "void main() {\n"
+  "  float coverage = uTextured ? texture(uTexture, vUv).r : 1.0;\n"
+  "  fragColor = vec4(vColor.rgb, vColor.a * coverage);\n"
+  "}\n";
+
+// Quads in submission order, and the same sorted by key when that order
+// differs
+static vertex_buffer buffer = null;
+static vertex_buffer sortedBuffer = null;
+static command_buffer commands = null;
+static GLuint program = 0;
+static GLint texturedLocation = -1;
+// Last value set on the program, -1 before the first flush
+static int texturedUniform = -1;
+static stream_buffer ring = null;
+static stream_stats_t lastStreamStats = {0};
+static boolean initialized = false;
+
+static uint8_t color[4] = {255, 255, 255, 255};
+static uint8_t layer = 0;
+static uint16_t depth = 0;
+static uint32_t boundTexture = 0;
+// Texture of the last draw, for counting texture changes
+static uint32_t drawnTexture = 0;
+static uint32_t solidTexture = 0;
+static float solidU = 0;
+static float solidV = 0;
+static int pendingQuads = 0;
+static soft_target softTarget = null;
+
+static const vertex_layout_t batchLayout = {
+  .stride = sizeof(batch_vertex_t),
+  .attribCount = 3,
+  .attribs = {
+    VERTEX_ATTRIB(ATTRIB_POSITION, ATTRIB_F32, 2, batch_vertex_t, x),
+    VERTEX_ATTRIB(ATTRIB_TEXCOORD, ATTRIB_F32, 2, batch_vertex_t, u),
+    VERTEX_ATTRIB(ATTRIB_COLOR, ATTRIB_U8, 4, batch_vertex_t, r)
+  }
+};
+
+static batch_stats_t frameStats = {0};
+static batch_stats_t lastFrameStats = {0};
+static batch_stats_t lastOverlayStats = {0};
+// The frame's counters while an overlay is recorded into frameStats
+static batch_stats_t pausedFrameStats = {0};
+static stream_stats_t overlayStreamStart = {0};
+
+boolean cgaBatchInit() {
+  if (initialized) {
+    return true;
+  }
+
+  buffer = cgaGenVertexBuffer();
+  sortedBuffer = cgaGenVertexBuffer();
+  commands = cgaGenCommandBuffer();
+
+  if (buffer == null || sortedBuffer == null || commands == null) {
+    logError("Failed to create quad batch buffers");
+    cgaFreeVertexBuffer(buffer);
+    cgaFreeVertexBuffer(sortedBuffer);
+    cgaFreeCommandBuffer(commands);
+    buffer = null;
+    sortedBuffer = null;
+    commands = null;
+    return false;
+  }
+
+  if (cgaIsCoreProfile()) {
+    program = cgaCreateProgram(batchVertexShader, batchFragmentShader);
+
+    if (program == 0) {
+      logError("Failed to create quad batch shader");
+      cgaFreeVertexBuffer(buffer);
+      cgaFreeVertexBuffer(sortedBuffer);
+      cgaFreeCommandBuffer(commands);
+      buffer = null;
+      sortedBuffer = null;
+      commands = null;
+      return false;
+    }
+
+    texturedLocation = glGetUniformLocation(program, "uTextured");
+
+    cgaGlUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "uTexture"), 0);
+  }
+
+  // Flushed a few times per frame, give back memory after a burst of
+  // unusually large batches
+  cgaSetBufferShrinkPolicy(buffer, BATCH_SHRINK_CLEARS);
+  cgaSetBufferShrinkPolicy(sortedBuffer, BATCH_SHRINK_CLEARS);
+
+  ring = cgaGenStreamBuffer(STREAM_RING_SIZE);
+
+  if (ring == null) {
+    logWarn("Failed to create batch stream buffer, uploading with glBufferData");
+  } else {
+    logDebugF("Batch stream buffer: %s", ring->mode == STREAM_MODE_PERSISTENT ? "persistent" : "orphaning");
+  }
+
+  initialized = true;
+  return true;
+}
+
+void cgaBatchClose() {
+  if (!initialized) {
+    return;
+  }
+
+  cgaFreeVertexBuffer(buffer);
+  cgaFreeVertexBuffer(sortedBuffer);
+  cgaFreeCommandBuffer(commands);
+  cgaFreeStreamBuffer(ring);
+  cgaFreeProgram(program);
+  program = 0;
+  texturedUniform = -1;
+  buffer = null;
+  sortedBuffer = null;
+  commands = null;
+  ring = null;
+  initialized = false;
+}
+
+void cgaBatchSetColor4ub(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+  color[0] = r;
+  color[1] = g;
+  color[2] = b;
+  color[3] = a;
+}
+
+void cgaBatchSetColor3ub(uint8_t r, uint8_t g, uint8_t b) {
+  cgaBatchSetColor4ub(r, g, b, 255);
+}
+
+void cgaBatchSetColor3f(float r, float g, float b) {
+  cgaBatchSetColor4ub(TO_U8(r), TO_U8(g), TO_U8(b), 255);
+}
+
+void cgaBatchSetLayer(uint8_t newLayer) {
+  layer = newLayer;
+}
+
+void cgaBatchSetDepth(uint16_t newDepth) {
+  depth = newDepth;
+}
+
+// Records the last `vertexCount` vertices written to the buffer
+static void submit(int vertexCount) {
+  uint32_t first = buffer->length / sizeof(batch_vertex_t) - (uint32_t) vertexCount;
+  uint64_t key = RENDER_KEY(layer, program, boundTexture, RENDER_KEY_COLOR(color[0], color[1], color[2]), depth);
+
+  cgaSubmitCommand(commands, key, program, boundTexture, first, (uint32_t) vertexCount);
+}
+
+static void setVertex(batch_vertex_t* v, float x, float y, float tu, float tv) {
+  v->x = x;
+  v->y = y;
+  v->u = tu;
+  v->v = tv;
+  v->r = 255;
+  v->g = 255;
+  v->b = 255;
+  v->a = 255;
+}
+
+void cgaBatchBuildQuad(
+  batch_vertex_t* out,
+  float startX, float startY, float endX, float endY,
+  float u0, float v0, float u1, float v1
+) {
+  // 2 triangles, same corner order drawQuad used for GL_QUADS
+  setVertex(&out[0], startX, startY, u0, v0);
+  setVertex(&out[1], endX, startY, u1, v0);
+  setVertex(&out[2], endX, endY, u1, v1);
+
+  setVertex(&out[3], startX, startY, u0, v0);
+  setVertex(&out[4], endX, endY, u1, v1);
+  setVertex(&out[5], startX, endY, u0, v1);
+}
+
+static void pushQuad(
+  float startX, float startY, float endX, float endY,
+  float u0, float v0, float u1, float v1
+) {
+  batch_vertex_t* quad = cgaWriteVertices(buffer, &batchLayout, BATCH_VERTICES_PER_QUAD);
+
+  if (quad == null) {
+    return;
+  }
+
+  cgaBatchBuildQuad(quad, startX, startY, endX, endY, u0, v0, u1, v1);
+
+  for (int i = 0; i < BATCH_VERTICES_PER_QUAD; i++) {
+    quad[i].r = color[0];
+    quad[i].g = color[1];
+    quad[i].b = color[2];
+    quad[i].a = color[3];
+  }
+
+  submit(BATCH_VERTICES_PER_QUAD);
+  pendingQuads++;
+  frameStats.quads++;
+  frameStats.vertices += BATCH_VERTICES_PER_QUAD;
+}
+
+void cgaBatchQuad(float startX, float startY, float endX, float endY) {
+  if (softTarget != null) {
+    cgaSoftSetColor4ub(softTarget, color[0], color[1], color[2], color[3]);
+    cgaSoftQuad(softTarget, startX, startY, endX, endY);
+    frameStats.quads++;
+    return;
+  }
+
+  if (!initialized) {
+    return;
+  }
+
+  cgaBatchSetTexture(solidTexture);
+  pushQuad(startX, startY, endX, endY, solidU, solidV, solidU, solidV);
+}
+
+void cgaBatchTexturedQuad(
+  uint32_t textureId,
+  float startX, float startY, float endX, float endY,
+  float u0, float v0, float u1, float v1
+) {
+  if (!initialized || softTarget != null) {
+    return;
+  }
+
+  cgaBatchSetTexture(textureId);
+  pushQuad(startX, startY, endX, endY, u0, v0, u1, v1);
+}
+
+void cgaBatchQuadRun(
+  uint32_t textureId,
+  const batch_vertex_t* vertices, int quadCount,
+  float offsetX, float offsetY
+) {
+  if (!initialized || softTarget != null || quadCount < 1) {
+    return;
+  }
+
+  cgaBatchSetTexture(textureId);
+
+  int vertexCount = quadCount * BATCH_VERTICES_PER_QUAD;
+  batch_vertex_t* out = cgaWriteVertices(buffer, &batchLayout, vertexCount);
+
+  if (out == null) {
+    return;
+  }
+
+  for (int i = 0; i < vertexCount; i++) {
+    out[i].x = vertices[i].x + offsetX;
+    out[i].y = vertices[i].y + offsetY;
+    out[i].u = vertices[i].u;
+    out[i].v = vertices[i].v;
+    out[i].r = color[0];
+    out[i].g = color[1];
+    out[i].b = color[2];
+    out[i].a = color[3];
+  }
+
+  submit(vertexCount);
+  pendingQuads += quadCount;
+  frameStats.quads += quadCount;
+  frameStats.vertices += vertexCount;
+}
+
+void cgaBatchSetSolidTexture(uint32_t textureId, float u, float v) {
+  solidTexture = textureId;
+  solidU = u;
+  solidV = v;
+}
+
+// Part of the sort key, switching doesn't end the batch
+void cgaBatchSetTexture(uint32_t textureId) {
+  boundTexture = textureId;
+}
+
+// Copies the vertices into sorted order, or returns the submission buffer
+// when the sort didn't move anything
+static vertex_buffer sortedVertices() {
+  uint32_t next = 0;
+  boolean inOrder = true;
+
+  for (int i = 0; i < commands->count && inOrder; i++) {
+    inOrder = commands->commands[i].first == next;
+    next += commands->commands[i].count;
+  }
+
+  if (inOrder) {
+    return buffer;
+  }
+
+  batch_vertex_t* out = cgaWriteVertices(sortedBuffer, &batchLayout, buffer->length / sizeof(batch_vertex_t));
+
+  if (out == null) {
+    return null;
+  }
+
+  const batch_vertex_t* in = (const batch_vertex_t*) buffer->data;
+
+  for (int i = 0; i < commands->count; i++) {
+    const render_command_t* cmd = &commands->commands[i];
+    memcpy(out, in + cmd->first, cmd->count * sizeof(batch_vertex_t));
+    out += cmd->count;
+  }
+
+  return sortedBuffer;
+}
+
+static void setDrawState(uint32_t textureId) {
+  boolean textured = textureId != 0;
+
+  // State is left set for the next draw, the cache skips what's unchanged
+  if (program != 0) {
+    cgaGlUseProgram(program);
+
+    if (texturedUniform != textured) {
+      glUniform1i(texturedLocation, textured);
+      texturedUniform = textured;
+    }
+  } else {
+    // Vertex colour times texture alpha, GL_MODULATE is the default
+    cgaGlSetEnabled(GL_TEXTURE_2D, textured);
+  }
+
+  if (textured) {
+    cgaGlBindTexture(textureId);
+    cgaGlBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  }
+
+  cgaGlSetEnabled(GL_BLEND, textured);
+
+  if (textureId != drawnTexture) {
+    drawnTexture = textureId;
+    frameStats.textureChanges++;
+  }
+}
+
+void cgaBatchFlush() {
+  if (!initialized || pendingQuads == 0) {
+    return;
+  }
+
+  cgaSortCommands(commands);
+  vertex_buffer vertices = sortedVertices();
+
+  if (vertices == null) {
+    logError("Failed to sort batched quads");
+    vertices = buffer;
+  }
+
+  cgaBindBuffer(vertices);
+
+  // Suballocate from the ring, the buffer's own VBO is only the fallback
+  // when the ring can't take the data
+  int64_t offset = cgaStreamVertexBuffer(ring, vertices);
+
+  if (offset < 0) {
+    cgaGlBindBuffer(GL_ARRAY_BUFFER, vertices->bufferId);
+    cgaUploadBuffer(vertices, GL_STREAM_DRAW);
+    offset = 0;
+  }
+
+  // Texture coordinates are ignored while GL_TEXTURE_2D is disabled
+  cgaEnableVertexLayout(&batchLayout, (uintptr_t) offset);
+
+  // One draw per run of commands sharing program and texture, the runs
+  // are contiguous in the sorted vertices
+  GLint first = 0;
+
+  for (int i = 0; i < commands->count;) {
+    int run = cgaCommandRunLength(commands, i);
+    GLsizei count = 0;
+
+    for (int j = i; j < i + run; j++) {
+      count += (GLsizei) commands->commands[j].count;
+    }
+
+    setDrawState(commands->commands[i].texture);
+    cgaGlDrawArrays(GL_TRIANGLES, first, count);
+
+    first += count;
+    i += run;
+    frameStats.drawCalls++;
+  }
+
+  cgaDisableVertexLayout(&batchLayout);
+
+  frameStats.commands += commands->count;
+
+  cgaClearCommands(commands);
+  cgaClearBuffer(buffer);
+  cgaClearBuffer(sortedBuffer);
+  pendingQuads = 0;
+}
+
+void cgaBatchEndFrame() {
+  cgaBatchFlush();
+
+  if (ring != null) {
+    cgaStreamEndFrame(ring);
+
+    stream_stats_t streamStats;
+    cgaStreamGetStats(ring, &streamStats);
+
+    frameStats.uploadBytes = (uint32_t) (streamStats.bytesUploaded - lastStreamStats.bytesUploaded);
+    frameStats.uploadStalls = (int) (streamStats.stalls - lastStreamStats.stalls);
+    lastStreamStats = streamStats;
+  }
+
+  lastFrameStats = frameStats;
+  frameStats = (batch_stats_t) {0};
+}
+
+void cgaBatchGetStats(batch_stats_t* stats) {
+  *stats = lastFrameStats;
+}
+
+void cgaBatchBeginOverlay() {
+  cgaBatchFlush();
+
+  pausedFrameStats = frameStats;
+  frameStats = (batch_stats_t) {0};
+
+  if (ring != null) {
+    cgaStreamGetStats(ring, &overlayStreamStart);
+  }
+}
+
+void cgaBatchEndOverlay() {
+  cgaBatchFlush();
+
+  if (ring != null) {
+    stream_stats_t streamStats;
+    cgaStreamGetStats(ring, &streamStats);
+
+    uint64_t bytes = streamStats.bytesUploaded - overlayStreamStart.bytesUploaded;
+    uint32_t stalls = streamStats.stalls - overlayStreamStart.stalls;
+
+    frameStats.uploadBytes = (uint32_t) bytes;
+    frameStats.uploadStalls = (int) stalls;
+
+    // Keeps the overlay's uploads out of the frame's
+    lastStreamStats.bytesUploaded += bytes;
+    lastStreamStats.stalls += stalls;
+  }
+
+  lastOverlayStats = frameStats;
+  frameStats = pausedFrameStats;
+}
+
+void cgaBatchGetOverlayStats(batch_stats_t* stats) {
+  *stats = lastOverlayStats;
+}
+
+void cgaBatchSetSoftTarget(soft_target target) {
+  cgaBatchFlush();
+  softTarget = target;
+}
+
+soft_target cgaBatchGetSoftTarget() {
+  return softTarget;
+}
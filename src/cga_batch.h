@@ -0,0 +1,124 @@
+#ifndef CGA_BATCH_H
+#define CGA_BATCH_H
+
+#include <stdint.h>
+#include "cga_core.h"
+#include "cga_soft.h"
+
+// Quad batcher
+//
+// Collects solid colour and textured quads into a vertex_buffer and submits
+// them when cgaBatchFlush is called or at the end of the frame in cgaLoop.
+// Quads are recorded as commands keyed by layer, program, texture, colour
+// and depth (cga_render.h). A flush sorts them by key and draws every run
+// sharing program and texture with one draw call, so callers can draw in
+// any order and only the layer decides what ends up on top. Vertices are
+// streamed through a ring buffer instead of reallocating a VBO every flush.
+//
+// If a solid texture is set, plain quads sample one opaque texel of it, so
+// solid quads and glyphs from the same atlas share one draw call.
+
+#define BATCH_VERTICES_PER_QUAD 6
+
+typedef struct BatchVertex {
+  float x;
+  float y;
+  float u;
+  float v;
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint8_t a;
+} batch_vertex_t;
+
+typedef struct BatchStats {
+  int quads;
+  int vertices;
+  int drawCalls;
+  // Sorted commands, consecutive quads with the same key share one
+  int commands;
+  // Times the bound texture switched between draw calls
+  int textureChanges;
+  // Vertex bytes streamed this frame and how many times that had to wait
+  // for the GPU, see cgaStreamUpload
+  uint32_t uploadBytes;
+  int uploadStalls;
+} batch_stats_t;
+
+boolean cgaBatchInit();
+
+void cgaBatchClose();
+
+void cgaBatchSetColor3ub(uint8_t r, uint8_t g, uint8_t b);
+
+void cgaBatchSetColor4ub(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+void cgaBatchSetColor3f(float r, float g, float b);
+
+// Layer of the following quads, higher layers are drawn over lower ones.
+// Quads on the same layer are ordered by texture and colour, not by call
+// order, so overlapping quads need different layers.
+void cgaBatchSetLayer(uint8_t layer);
+
+// Sorts quads that share layer, texture and colour, lower first
+void cgaBatchSetDepth(uint16_t depth);
+
+void cgaBatchQuad(float startX, float startY, float endX, float endY);
+
+// (u0, v0) maps to (startX, startY) and (u1, v1) to (endX, endY)
+void cgaBatchTexturedQuad(
+  uint32_t textureId,
+  float startX, float startY, float endX, float endY,
+  float u0, float v0, float u1, float v1
+);
+
+// Appends quads built with cgaBatchBuildQuad, moved by (offsetX, offsetY)
+// and drawn in the current colour
+void cgaBatchQuadRun(
+  uint32_t textureId,
+  const batch_vertex_t* vertices, int quadCount,
+  float offsetX, float offsetY
+);
+
+// Writes the BATCH_VERTICES_PER_QUAD vertices of a quad into out, colour is
+// left white
+void cgaBatchBuildQuad(
+  batch_vertex_t* out,
+  float startX, float startY, float endX, float endY,
+  float u0, float v0, float u1, float v1
+);
+
+// Texture and texel coordinate plain quads are drawn with, the texel must
+// have an alpha of 1. A textureId of 0 draws plain quads untextured.
+void cgaBatchSetSolidTexture(uint32_t textureId, float u, float v);
+
+// Texture bound for the following quads, 0 for untextured
+void cgaBatchSetTexture(uint32_t textureId);
+
+// Sorts and submits every queued quad. Drawing that bypasses the batch
+// flushes first to stay over what was queued before it.
+void cgaBatchFlush();
+
+// Flushes and moves the counters of this frame into cgaBatchGetStats
+void cgaBatchEndFrame();
+
+// Counters of the last finished frame
+void cgaBatchGetStats(batch_stats_t* stats);
+
+// Quads between these are counted apart from the frame, so a debug overlay
+// doesn't show up in the stats it displays. Both flush.
+void cgaBatchBeginOverlay();
+
+void cgaBatchEndOverlay();
+
+// Counters of the last overlay
+void cgaBatchGetOverlayStats(batch_stats_t* stats);
+
+// Sends plain quads to a software target instead of GL until reset with
+// null. Textured quads are dropped, text switches to per-pixel quads.
+// The caller flushes the target.
+void cgaBatchSetSoftTarget(soft_target target);
+
+soft_target cgaBatchGetSoftTarget();
+
+#endif // CGA_BATCH_H
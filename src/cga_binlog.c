@@ -0,0 +1,332 @@
+#include "cga_binlog.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+// Largest event: header plus BINLOG_MAX_ARGS strings at their length cap
+#define EVENT_HEADER_SIZE (1 + 2 + 1 + 8)
+#define MAX_EVENT_SIZE (EVENT_HEADER_SIZE + BINLOG_MAX_ARGS * (1 + 1 + 2 + BINLOG_MAX_STRING))
+
+typedef struct ThreadBuffer {
+  uint8_t data[BINLOG_THREAD_BUFFER];
+  size_t used;
+  // File generation the data belongs to, older data is dropped
+  int generation;
+  // Held by the owning thread while it appends and by whoever writes the
+  // buffer out. Taken after fileLock, never before it.
+  atomic_flag busy;
+  struct ThreadBuffer* next;
+  struct ThreadBuffer** prev;
+} thread_buffer_t;
+
+static pthread_mutex_t fileLock = PTHREAD_MUTEX_INITIALIZER;
+static FILE* file = null;
+// Atomic because events read it without fileLock
+static _Atomic double startTime = 0;
+static int nextId = 0;
+
+// Bumped by every open and close, sites and buffered data from another
+// file are stale
+static atomic_int generation = 0;
+static atomic_int fileOpen = 0;
+static boolean exitHookInstalled = false;
+
+// Buffers of every live thread that logged. A buffer stays valid until its
+// thread exits, so close can write it out while the thread keeps logging.
+static thread_buffer_t* buffers = null;
+
+static pthread_once_t bufferKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t bufferKey;
+
+static _Thread_local thread_buffer_t* localBuffer = null;
+
+static uint8_t* put(uint8_t* dst, const void* src, size_t size) {
+  memcpy(dst, src, size);
+  return dst + size;
+}
+
+static void lockBuffer(thread_buffer_t* buffer) {
+  while (atomic_flag_test_and_set_explicit(&buffer->busy, memory_order_acquire)) {
+    sched_yield();
+  }
+}
+
+static void unlockBuffer(thread_buffer_t* buffer) {
+  atomic_flag_clear_explicit(&buffer->busy, memory_order_release);
+}
+
+// Caller holds fileLock and the buffer
+static void writeBuffer(thread_buffer_t* buffer) {
+  if (buffer->used > 0 && file != null && buffer->generation == atomic_load(&generation)) {
+    fwrite(buffer->data, 1, buffer->used, file);
+  }
+
+  buffer->used = 0;
+}
+
+// Thread exit, writes out what's left and unlinks the buffer
+static void releaseBuffer(void* arg) {
+  thread_buffer_t* buffer = arg;
+
+  pthread_mutex_lock(&fileLock);
+  lockBuffer(buffer);
+  writeBuffer(buffer);
+
+  *buffer->prev = buffer->next;
+
+  if (buffer->next != null) {
+    buffer->next->prev = buffer->prev;
+  }
+
+  pthread_mutex_unlock(&fileLock);
+  free(buffer);
+
+  // Later thread-local destructors may still log into a new buffer
+  localBuffer = null;
+}
+
+static void createBufferKey() {
+  pthread_key_create(&bufferKey, releaseBuffer);
+}
+
+static thread_buffer_t* acquireBuffer() {
+  if (localBuffer != null) {
+    return localBuffer;
+  }
+
+  thread_buffer_t* buffer = malloc(sizeof(thread_buffer_t));
+
+  if (buffer == null) {
+    return null;
+  }
+
+  buffer->used = 0;
+  atomic_flag_clear(&buffer->busy);
+  pthread_once(&bufferKeyOnce, createBufferKey);
+
+  pthread_mutex_lock(&fileLock);
+
+  if (file == null) {
+    pthread_mutex_unlock(&fileLock);
+    free(buffer);
+    return null;
+  }
+
+  buffer->generation = atomic_load(&generation);
+  buffer->next = buffers;
+  buffer->prev = &buffers;
+
+  if (buffers != null) {
+    buffers->prev = &buffer->next;
+  }
+
+  buffers = buffer;
+  pthread_mutex_unlock(&fileLock);
+
+  pthread_setspecific(bufferKey, buffer);
+  localBuffer = buffer;
+
+  return buffer;
+}
+
+// Assigns the site its ID in the current file and writes its FORMAT record
+static boolean registerSite(binlog_site_t* site) {
+  pthread_mutex_lock(&fileLock);
+
+  int current = atomic_load(&generation);
+
+  if (file == null) {
+    pthread_mutex_unlock(&fileLock);
+    return false;
+  }
+
+  if (atomic_load_explicit(&site->generation, memory_order_relaxed) == current) {
+    pthread_mutex_unlock(&fileLock);
+    return true;
+  }
+
+  uint8_t type = BINLOG_RECORD_FORMAT;
+  uint16_t id = (uint16_t) nextId++;
+  uint8_t level = (uint8_t) site->level;
+  uint32_t line = (uint32_t) site->line;
+  uint16_t fileLength = (uint16_t) strlen(site->file);
+  uint16_t formatLength = (uint16_t) strlen(site->format);
+
+  fwrite(&type, sizeof(type), 1, file);
+  fwrite(&id, sizeof(id), 1, file);
+  fwrite(&level, sizeof(level), 1, file);
+  fwrite(&line, sizeof(line), 1, file);
+  fwrite(&fileLength, sizeof(fileLength), 1, file);
+  fwrite(site->file, 1, fileLength, file);
+  fwrite(&formatLength, sizeof(formatLength), 1, file);
+  fwrite(site->format, 1, formatLength, file);
+
+  atomic_store_explicit(&site->id, id, memory_order_relaxed);
+  atomic_store_explicit(&site->generation, current, memory_order_release);
+
+  pthread_mutex_unlock(&fileLock);
+  return true;
+}
+
+static void onExit() {
+  cgaBinLogClose();
+}
+
+boolean cgaBinLogOpen(const char* path) {
+  if (atomic_load(&fileOpen)) {
+    cgaBinLogClose();
+  }
+
+  FILE* f = fopen(path, "wb");
+
+  if (f == null) {
+    logErrorF("Failed to open binary log '%s'", path);
+    return false;
+  }
+
+  binlog_header_t header = {
+    .magic = BINLOG_MAGIC,
+    .version = BINLOG_VERSION,
+    .startTime = (int64_t) time(null)
+  };
+
+  if (fwrite(&header, sizeof(header), 1, f) != 1) {
+    logErrorF("Failed to write binary log header to '%s'", path);
+    fclose(f);
+    return false;
+  }
+
+  pthread_mutex_lock(&fileLock);
+  file = f;
+  startTime = cgaGetTime();
+  nextId = 0;
+  atomic_fetch_add(&generation, 1);
+  atomic_store(&fileOpen, 1);
+  pthread_mutex_unlock(&fileLock);
+
+  if (!exitHookInstalled) {
+    atexit(onExit);
+    exitHookInstalled = true;
+  }
+
+  return true;
+}
+
+void cgaBinLogClose() {
+  if (!atomic_exchange(&fileOpen, 0)) {
+    return;
+  }
+
+  pthread_mutex_lock(&fileLock);
+
+  // Threads that are still logging keep their buffers, anything they add
+  // from here on belongs to the closed file and is dropped
+  for (thread_buffer_t* buffer = buffers; buffer != null; buffer = buffer->next) {
+    lockBuffer(buffer);
+    writeBuffer(buffer);
+    unlockBuffer(buffer);
+  }
+
+  atomic_fetch_add(&generation, 1);
+
+  fclose(file);
+  file = null;
+
+  pthread_mutex_unlock(&fileLock);
+}
+
+boolean cgaBinLogIsOpen() {
+  return atomic_load_explicit(&fileOpen, memory_order_relaxed) != 0;
+}
+
+void cgaBinLogWrite(binlog_site_t* site, const binlog_arg_t* args, int count) {
+  int current = atomic_load_explicit(&generation, memory_order_acquire);
+
+  if (atomic_load_explicit(&site->generation, memory_order_acquire) != current && !registerSite(site)) {
+    return;
+  }
+
+  thread_buffer_t* buffer = acquireBuffer();
+
+  if (buffer == null) {
+    return;
+  }
+
+  lockBuffer(buffer);
+
+  if (buffer->generation != current) {
+    buffer->generation = current;
+    buffer->used = 0;
+  }
+
+  if (buffer->used + MAX_EVENT_SIZE > BINLOG_THREAD_BUFFER) {
+    // Lock order is fileLock first, let go of the buffer while waiting
+    unlockBuffer(buffer);
+    pthread_mutex_lock(&fileLock);
+    lockBuffer(buffer);
+    writeBuffer(buffer);
+    pthread_mutex_unlock(&fileLock);
+  }
+
+  if (count > BINLOG_MAX_ARGS) {
+    count = BINLOG_MAX_ARGS;
+  }
+
+  uint8_t* dst = buffer->data + buffer->used;
+  uint8_t type = BINLOG_RECORD_EVENT;
+  uint16_t id = (uint16_t) atomic_load_explicit(&site->id, memory_order_relaxed);
+  uint8_t argCount = (uint8_t) count;
+  double seconds = cgaGetTime() - atomic_load_explicit(&startTime, memory_order_relaxed);
+
+  dst = put(dst, &type, sizeof(type));
+  dst = put(dst, &id, sizeof(id));
+  dst = put(dst, &argCount, sizeof(argCount));
+  dst = put(dst, &seconds, sizeof(seconds));
+
+  for (int i = 0; i < count; i++) {
+    uint8_t argType = (uint8_t) args[i].type;
+    dst = put(dst, &argType, sizeof(argType));
+    dst = put(dst, &args[i].width, sizeof(args[i].width));
+
+    if (args[i].type != BINLOG_ARG_STRING) {
+      dst = put(dst, &args[i].u, sizeof(uint64_t));
+      continue;
+    }
+
+    const char* str = args[i].s != null ? args[i].s : "(null)";
+    size_t length = strnlen(str, BINLOG_MAX_STRING);
+    uint16_t length16 = (uint16_t) length;
+
+    dst = put(dst, &length16, sizeof(length16));
+    dst = put(dst, str, length);
+  }
+
+  buffer->used = (size_t) (dst - buffer->data);
+  unlockBuffer(buffer);
+}
+
+void cgaBinLogFlush() {
+  if (!cgaBinLogIsOpen()) {
+    return;
+  }
+
+  thread_buffer_t* buffer = acquireBuffer();
+
+  pthread_mutex_lock(&fileLock);
+
+  if (buffer != null) {
+    lockBuffer(buffer);
+    writeBuffer(buffer);
+    unlockBuffer(buffer);
+  }
+
+  if (file != null) {
+    fflush(file);
+  }
+
+  pthread_mutex_unlock(&fileLock);
+}
@@ -0,0 +1,182 @@
+#ifndef CGA_BINLOG_H
+#define CGA_BINLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "cga_core.h"
+
+// Binary log
+//
+// Call sites store a format ID and their raw arguments instead of a
+// formatted string, log_decode renders the file to text offline. Every
+// call site is a static binlog_site_t that gets its ID the first time it
+// logs into a file. Records are collected in a buffer per thread and
+// appended to the file when it fills up.
+//
+// File layout, all fields little-endian:
+//
+//   binlog_header_t
+//   records      a one byte binlog_record_type_t, then
+//     FORMAT     u16 id, u8 level, u32 line, u16 fileLength, file,
+//                u16 formatLength, format
+//     EVENT      u16 id, u8 argCount, f64 seconds since the header's
+//                startTime, argCount times:
+//                  u8 binlog_arg_type_t, u8 width, then 8 value bytes,
+//                  or for strings u16 length and the characters
+//
+// width is an integer's size after default argument promotion, the decoder
+// cuts values to it so %x of a negative int prints like printf would.
+//
+// A FORMAT record is always written before the first EVENT using its ID.
+
+#define BINLOG_MAGIC 0x474C4243 // "CBLG"
+#define BINLOG_VERSION 2
+#define BINLOG_MAX_ARGS 8
+#define BINLOG_MAX_STRING 256
+#define BINLOG_THREAD_BUFFER (64 * 1024)
+
+typedef struct BinLogHeader {
+  uint32_t magic;
+  uint32_t version;
+  // Unix time the log was opened at
+  int64_t startTime;
+} binlog_header_t;
+
+typedef enum {
+  BINLOG_RECORD_FORMAT = 1,
+  BINLOG_RECORD_EVENT = 2
+} binlog_record_type_t;
+
+typedef enum {
+  BINLOG_ARG_INT,
+  BINLOG_ARG_UINT,
+  BINLOG_ARG_DOUBLE,
+  BINLOG_ARG_STRING,
+  BINLOG_ARG_POINTER
+} binlog_arg_type_t;
+
+typedef struct BinLogArg {
+  binlog_arg_type_t type;
+  uint8_t width;
+  union {
+    int64_t i;
+    uint64_t u;
+    double d;
+    const char* s;
+  };
+} binlog_arg_t;
+
+typedef struct BinLogSite {
+  const char* format;
+  const char* file;
+  int line;
+  int level;
+
+  // ID in the file of generation `generation`, see cgaBinLogWrite. Atomic
+  // because a reopen can reassign it while another thread logs.
+  atomic_int id;
+  atomic_int generation;
+} binlog_site_t;
+
+// Only integers keep their width, everything else is stored as 8 bytes
+static inline binlog_arg_t binlogInt(long long v, size_t width) {
+  return (binlog_arg_t) {.type = BINLOG_ARG_INT, .width = (uint8_t) width, .i = v};
+}
+
+static inline binlog_arg_t binlogUint(unsigned long long v, size_t width) {
+  return (binlog_arg_t) {.type = BINLOG_ARG_UINT, .width = (uint8_t) width, .u = v};
+}
+
+static inline binlog_arg_t binlogDouble(double v, size_t width) {
+  (void) width;
+  return (binlog_arg_t) {.type = BINLOG_ARG_DOUBLE, .width = 8, .d = v};
+}
+
+static inline binlog_arg_t binlogString(const void* v, size_t width) {
+  (void) width;
+  return (binlog_arg_t) {.type = BINLOG_ARG_STRING, .width = 8, .s = v};
+}
+
+static inline binlog_arg_t binlogPointer(const void* v, size_t width) {
+  (void) width;
+  return (binlog_arg_t) {.type = BINLOG_ARG_POINTER, .width = 8, .u = (uintptr_t) v};
+}
+
+// Variadic calls promote anything narrower than int to int
+#define BINLOG_ARG_WIDTH(x) (sizeof(x) < sizeof(int) ? sizeof(int) : sizeof(x))
+
+// Picks the encoding from the argument's static type, character pointers
+// are copied as strings and other pointers as their address
+#define BINLOG_ARG(x) _Generic((x), \
+  _Bool: binlogUint, \
+  char: binlogInt, \
+  signed char: binlogInt, \
+  unsigned char: binlogUint, \
+  short: binlogInt, \
+  unsigned short: binlogUint, \
+  int: binlogInt, \
+  unsigned int: binlogUint, \
+  long: binlogInt, \
+  unsigned long: binlogUint, \
+  long long: binlogInt, \
+  unsigned long long: binlogUint, \
+  float: binlogDouble, \
+  double: binlogDouble, \
+  char*: binlogString, \
+  const char*: binlogString, \
+  unsigned char*: binlogString, \
+  const unsigned char*: binlogString, \
+  default: binlogPointer \
+)(x, BINLOG_ARG_WIDTH(x))
+
+#define BINLOG_CAT_(a, b) a##b
+#define BINLOG_CAT(a, b) BINLOG_CAT_(a, b)
+#define BINLOG_NARGS_(a1, a2, a3, a4, a5, a6, a7, a8, n, ...) n
+#define BINLOG_NARGS(...) BINLOG_NARGS_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define BINLOG_MAP_1(a) BINLOG_ARG(a)
+#define BINLOG_MAP_2(a, ...) BINLOG_ARG(a), BINLOG_MAP_1(__VA_ARGS__)
+#define BINLOG_MAP_3(a, ...) BINLOG_ARG(a), BINLOG_MAP_2(__VA_ARGS__)
+#define BINLOG_MAP_4(a, ...) BINLOG_ARG(a), BINLOG_MAP_3(__VA_ARGS__)
+#define BINLOG_MAP_5(a, ...) BINLOG_ARG(a), BINLOG_MAP_4(__VA_ARGS__)
+#define BINLOG_MAP_6(a, ...) BINLOG_ARG(a), BINLOG_MAP_5(__VA_ARGS__)
+#define BINLOG_MAP_7(a, ...) BINLOG_ARG(a), BINLOG_MAP_6(__VA_ARGS__)
+#define BINLOG_MAP_8(a, ...) BINLOG_ARG(a), BINLOG_MAP_7(__VA_ARGS__)
+#define BINLOG_MAP(...) BINLOG_CAT(BINLOG_MAP_, BINLOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+
+// Logs into the binary log if one is open, through cgaLog otherwise
+#define CGA_BINLOG(lvl, fmt, ...) do { \
+    static binlog_site_t binlogSite_ = {.format = fmt, .file = __FILE__, .line = __LINE__, .level = lvl}; \
+    if (cgaBinLogIsOpen()) { \
+      binlog_arg_t binlogArgs_[] = {BINLOG_MAP(__VA_ARGS__)}; \
+      cgaBinLogWrite(&binlogSite_, binlogArgs_, (int) (sizeof(binlogArgs_) / sizeof(binlog_arg_t))); \
+    } else { \
+      cgaLog(lvl, fmt, __VA_ARGS__); \
+    } \
+  } while (0)
+
+#define CGA_BINLOG_0(lvl, fmt) do { \
+    static binlog_site_t binlogSite_ = {.format = fmt, .file = __FILE__, .line = __LINE__, .level = lvl}; \
+    if (cgaBinLogIsOpen()) { \
+      cgaBinLogWrite(&binlogSite_, null, 0); \
+    } else { \
+      cgaLog(lvl, fmt); \
+    } \
+  } while (0)
+
+boolean cgaBinLogOpen(const char* path);
+
+// Writes out every thread's buffer, also runs at exit. Threads may keep
+// logging, what they log after this is dropped.
+void cgaBinLogClose();
+
+boolean cgaBinLogIsOpen();
+
+// At most BINLOG_MAX_ARGS arguments, strings are cut at BINLOG_MAX_STRING
+void cgaBinLogWrite(binlog_site_t* site, const binlog_arg_t* args, int count);
+
+// Appends the calling thread's buffer to the file
+void cgaBinLogFlush();
+
+#endif // CGA_BINLOG_H
@@ -0,0 +1,101 @@
+#include "cga_capture.h"
+#include "log.h"
+#include <GL/glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHANNELS 3
+
+// Returns width * height RGB pixels, flipped so the top row comes first
+static uint8_t* readFrame(int width, int height) {
+  size_t rowSize = (size_t) width * CHANNELS;
+  uint8_t* pixels = malloc(rowSize * height);
+  uint8_t* flipped = malloc(rowSize * height);
+
+  if (pixels == null || flipped == null) {
+    logError("Failed to allocate frame capture buffers");
+    free(pixels);
+    free(flipped);
+    return null;
+  }
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+  for (int y = 0; y < height; y++) {
+    memcpy(flipped + rowSize * y, pixels + rowSize * (height - 1 - y), rowSize);
+  }
+
+  free(pixels);
+  return flipped;
+}
+
+boolean cgaCaptureFrame(const char* path, int width, int height) {
+  uint8_t* pixels = readFrame(width, height);
+
+  if (pixels == null) {
+    return false;
+  }
+
+  FILE* file = fopen(path, "wb");
+
+  if (file == null) {
+    logErrorF("Failed to open %s for writing", path);
+    free(pixels);
+    return false;
+  }
+
+  size_t size = (size_t) width * height * CHANNELS;
+
+  fprintf(file, "P6\n%i %i\n255\n", width, height);
+  boolean ok = fwrite(pixels, 1, size, file) == size;
+
+  fclose(file);
+  free(pixels);
+  return ok;
+}
+
+long cgaCompareFrame(const char* path, int width, int height, int tolerance) {
+  FILE* file = fopen(path, "rb");
+
+  if (file == null) {
+    return -1;
+  }
+
+  int fileWidth = 0;
+  int fileHeight = 0;
+  int maxValue = 0;
+
+  // Single whitespace byte after the header, as cgaCaptureFrame writes it
+  if (fscanf(file, "P6 %i %i %i", &fileWidth, &fileHeight, &maxValue) != 3
+    || fileWidth != width || fileHeight != height || maxValue != 255) {
+    fclose(file);
+    return -1;
+  }
+
+  fgetc(file);
+
+  size_t size = (size_t) width * height * CHANNELS;
+  uint8_t* golden = malloc(size);
+  uint8_t* pixels = readFrame(width, height);
+  long mismatched = -1;
+
+  if (golden != null && pixels != null && fread(golden, 1, size, file) == size) {
+    mismatched = 0;
+
+    for (size_t i = 0; i < size; i += CHANNELS) {
+      for (int c = 0; c < CHANNELS; c++) {
+        if (abs(golden[i + c] - pixels[i + c]) > tolerance) {
+          mismatched++;
+          break;
+        }
+      }
+    }
+  }
+
+  fclose(file);
+  free(golden);
+  free(pixels);
+  return mismatched;
+}
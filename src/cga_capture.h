@@ -0,0 +1,16 @@
+#ifndef CGA_CAPTURE_H
+#define CGA_CAPTURE_H
+
+#include "cga_core.h"
+
+// Frame dumps as binary PPM (P6), top row first
+
+// Writes the current read framebuffer to path
+boolean cgaCaptureFrame(const char* path, int width, int height);
+
+// Compares the current read framebuffer with a dump. Returns the number of
+// pixels with a channel off by more than tolerance, or -1 if the dump is
+// missing or has a different size.
+long cgaCompareFrame(const char* path, int width, int height, int tolerance);
+
+#endif // CGA_CAPTURE_H
@@ -1,9 +1,81 @@
 #include "cga_core.h"
+#include "cga_profile.h"
 
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <time.h>
+  #include <unistd.h>
+#endif
+
+#define SPIN_ATTEMPTS 64
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+  #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+double cgaGetTime() {
+#ifdef _WIN32
+  static LARGE_INTEGER frequency = {0};
+  LARGE_INTEGER counter;
+
+  if (frequency.QuadPart == 0) {
+    QueryPerformanceFrequency(&frequency);
+  }
+
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart / (double) frequency.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+void cgaSleep(double seconds) {
+  if (seconds <= 0) {
+    return;
+  }
+
+#ifdef _WIN32
+  // Sleep() rounds up to the 15.6 ms scheduler tick, high resolution
+  // waitable timers (Windows 10 1803+) don't
+  static _Thread_local HANDLE timer = NULL;
+
+  if (timer == NULL) {
+    timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+  }
+
+  if (timer != NULL) {
+    LARGE_INTEGER due;
+    due.QuadPart = -(LONGLONG) (seconds * 1e7);
+
+    if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) {
+      WaitForSingleObject(timer, INFINITE);
+      return;
+    }
+  }
+
+  Sleep((DWORD) (seconds * 1e3));
+#else
+  struct timespec ts;
+  ts.tv_sec = (time_t) seconds;
+  ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1e9);
+
+  // Signals cut the sleep short, continue with what's left
+  while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+  }
+#endif
+}
 
 char* cgaFormatString(int maxlen, char* format, ...) {
   char buf[maxlen];
@@ -22,7 +94,417 @@ char* cgaFormatString(int maxlen, char* format, ...) {
   int memoryLength = (length + 1) * sizeof(char);
   char* resultBuf = malloc(memoryLength);
 
-  memcpy_s(resultBuf, memoryLength, buf, memoryLength);
+  if (resultBuf == null) {
+    return null;
+  }
+
+  memcpy(resultBuf, buf, memoryLength);
 
   return resultBuf;
 }
+
+//
+// Job system
+//
+
+typedef struct {
+  job_fn_t fn;
+  void* arg;
+  job_counter_t* counter;
+} job_t;
+
+// A thief with a stale top can read a slot while the owner refills it, the
+// failed CAS discards what it read. The fields are atomic so that read is
+// only a stale value instead of a data race.
+typedef struct {
+  _Atomic(job_fn_t) fn;
+  _Atomic(void*) arg;
+  _Atomic(job_counter_t*) counter;
+} job_slot_t;
+
+// Chase-Lev deque, the owner pushes and pops at the bottom, thieves take
+// from the top
+typedef struct {
+  atomic_llong top;
+  atomic_llong bottom;
+  job_slot_t jobs[JOBS_DEQUE_CAPACITY];
+} job_deque_t;
+
+typedef struct {
+  int start;
+  int end;
+  parallel_for_fn_t fn;
+  void* arg;
+} parallel_range_t;
+
+static job_deque_t* deques = null;
+static pthread_t workers[JOBS_MAX_WORKERS];
+static int workerCount = 0;
+static atomic_int running = 0;
+
+static pthread_mutex_t sleepLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sleepCond = PTHREAD_COND_INITIALIZER;
+static atomic_int sleepingWorkers = 0;
+static atomic_int queuedJobs = 0;
+
+// Jobs submitted from threads that don't own a deque
+static pthread_mutex_t injectLock = PTHREAD_MUTEX_INITIALIZER;
+static job_t injectQueue[JOBS_DEQUE_CAPACITY];
+static int injectHead = 0;
+static atomic_int injectCount = 0;
+
+static _Thread_local int workerIndex = -1;
+
+static int hardwareThreads() {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int) info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (int) count : 1;
+#endif
+}
+
+// Ordering comes from top and bottom, the slot fields are relaxed
+static void slotStore(job_slot_t* slot, job_t job) {
+  atomic_store_explicit(&slot->fn, job.fn, memory_order_relaxed);
+  atomic_store_explicit(&slot->arg, job.arg, memory_order_relaxed);
+  atomic_store_explicit(&slot->counter, job.counter, memory_order_relaxed);
+}
+
+static job_t slotLoad(job_slot_t* slot) {
+  return (job_t) {
+    .fn = atomic_load_explicit(&slot->fn, memory_order_relaxed),
+    .arg = atomic_load_explicit(&slot->arg, memory_order_relaxed),
+    .counter = atomic_load_explicit(&slot->counter, memory_order_relaxed)
+  };
+}
+
+static boolean dequePush(job_deque_t* d, job_t job) {
+  long long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+  long long t = atomic_load_explicit(&d->top, memory_order_acquire);
+
+  if (b - t >= JOBS_DEQUE_CAPACITY) {
+    return false;
+  }
+
+  slotStore(&d->jobs[b & (JOBS_DEQUE_CAPACITY - 1)], job);
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+
+  return true;
+}
+
+// The seq_cst store of bottom and load of top here, and the seq_cst loads
+// in dequeSteal, keep an owner and a thief from both taking the last job
+static boolean dequePop(job_deque_t* d, job_t* out) {
+  long long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&d->bottom, b, memory_order_seq_cst);
+  long long t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+
+  if (t > b) {
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return false;
+  }
+
+  *out = slotLoad(&d->jobs[b & (JOBS_DEQUE_CAPACITY - 1)]);
+
+  if (t != b) {
+    return true;
+  }
+
+  // Last job, race against thieves for it
+  boolean won = atomic_compare_exchange_strong_explicit(
+    &d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed
+  );
+
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  return won;
+}
+
+static boolean dequeSteal(job_deque_t* d, job_t* out) {
+  long long t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+  long long b = atomic_load_explicit(&d->bottom, memory_order_seq_cst);
+
+  if (t >= b) {
+    return false;
+  }
+
+  job_t job = slotLoad(&d->jobs[t & (JOBS_DEQUE_CAPACITY - 1)]);
+
+  if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+    return false;
+  }
+
+  *out = job;
+  return true;
+}
+
+static boolean injectPop(job_t* out) {
+  if (injectCount == 0) {
+    return false;
+  }
+
+  boolean found = false;
+  pthread_mutex_lock(&injectLock);
+
+  if (injectCount > 0) {
+    *out = injectQueue[injectHead];
+    injectHead = (injectHead + 1) % JOBS_DEQUE_CAPACITY;
+    injectCount--;
+    found = true;
+  }
+
+  pthread_mutex_unlock(&injectLock);
+  return found;
+}
+
+static boolean injectPush(job_t job) {
+  boolean pushed = false;
+  pthread_mutex_lock(&injectLock);
+
+  if (injectCount < JOBS_DEQUE_CAPACITY) {
+    injectQueue[(injectHead + injectCount) % JOBS_DEQUE_CAPACITY] = job;
+    injectCount++;
+    pushed = true;
+  }
+
+  pthread_mutex_unlock(&injectLock);
+  return pushed;
+}
+
+static void runJob(job_t* job) {
+  profileBegin("job");
+  job->fn(job->arg);
+  profileEnd();
+
+  if (job->counter != null) {
+    atomic_fetch_sub_explicit(&job->counter->pending, 1, memory_order_release);
+  }
+}
+
+// Own deque first, then the injection queue, then steal from the others
+// starting at the neighbour so thieves spread out
+static boolean findJob(job_t* out) {
+  if (deques == null) {
+    return false;
+  }
+
+  int self = workerIndex;
+
+  if (self >= 0 && dequePop(&deques[self], out)) {
+    return true;
+  }
+
+  if (injectPop(out)) {
+    return true;
+  }
+
+  for (int i = 1; i <= workerCount; i++) {
+    int victim = (self + i + workerCount) % workerCount;
+
+    if (victim == self) {
+      continue;
+    }
+
+    if (dequeSteal(&deques[victim], out)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static boolean runOneJob() {
+  job_t job;
+
+  if (!findJob(&job)) {
+    return false;
+  }
+
+  atomic_fetch_sub_explicit(&queuedJobs, 1, memory_order_relaxed);
+  runJob(&job);
+  return true;
+}
+
+static void* workerMain(void* arg) {
+  workerIndex = (int) (intptr_t) arg;
+  profileThreadName("job worker");
+
+  while (atomic_load_explicit(&running, memory_order_acquire)) {
+    boolean ran = false;
+
+    for (int i = 0; i < SPIN_ATTEMPTS && !ran; i++) {
+      ran = runOneJob();
+    }
+
+    if (ran) {
+      continue;
+    }
+
+    pthread_mutex_lock(&sleepLock);
+    atomic_fetch_add(&sleepingWorkers, 1);
+
+    while (atomic_load(&running) && atomic_load(&queuedJobs) <= 0) {
+      pthread_cond_wait(&sleepCond, &sleepLock);
+    }
+
+    atomic_fetch_sub(&sleepingWorkers, 1);
+    pthread_mutex_unlock(&sleepLock);
+  }
+
+  return null;
+}
+
+boolean cgaJobsInit(int count) {
+  if (atomic_load(&running)) {
+    return false;
+  }
+
+  if (count < 1) {
+    count = hardwareThreads();
+  }
+
+  if (count > JOBS_MAX_WORKERS) {
+    count = JOBS_MAX_WORKERS;
+  }
+
+  deques = calloc(count, sizeof(job_deque_t));
+
+  if (deques == null) {
+    return false;
+  }
+
+  workerCount = count;
+  workerIndex = 0;
+  atomic_store(&queuedJobs, 0);
+  atomic_store(&running, 1);
+
+  for (int i = 1; i < count; i++) {
+    if (pthread_create(&workers[i], null, workerMain, (void*) (intptr_t) i) != 0) {
+      workerCount = i;
+      break;
+    }
+  }
+
+  return true;
+}
+
+void cgaJobsShutdown() {
+  if (!atomic_load(&running)) {
+    return;
+  }
+
+  // Drain whatever is left before the workers go away
+  while (runOneJob()) {
+  }
+
+  pthread_mutex_lock(&sleepLock);
+  atomic_store(&running, 0);
+  pthread_cond_broadcast(&sleepCond);
+  pthread_mutex_unlock(&sleepLock);
+
+  for (int i = 1; i < workerCount; i++) {
+    pthread_join(workers[i], null);
+  }
+
+  free(deques);
+  deques = null;
+  workerCount = 0;
+  workerIndex = -1;
+}
+
+int cgaJobsWorkerCount() {
+  return atomic_load(&running) ? workerCount : 1;
+}
+
+void cgaJobSubmit(job_fn_t fn, void* arg, job_counter_t* counter) {
+  job_t job = {.fn = fn, .arg = arg, .counter = counter};
+
+  if (counter != null) {
+    atomic_fetch_add_explicit(&counter->pending, 1, memory_order_relaxed);
+  }
+
+  if (!atomic_load_explicit(&running, memory_order_acquire)) {
+    runJob(&job);
+    return;
+  }
+
+  boolean queued = false;
+
+  if (workerIndex >= 0) {
+    queued = dequePush(&deques[workerIndex], job);
+  } else {
+    queued = injectPush(job);
+  }
+
+  // Queue full, run it now rather than dropping it
+  if (!queued) {
+    runJob(&job);
+    return;
+  }
+
+  // Sequentially consistent so this can't miss a worker going to sleep
+  atomic_fetch_add(&queuedJobs, 1);
+
+  if (atomic_load(&sleepingWorkers) > 0) {
+    pthread_mutex_lock(&sleepLock);
+    pthread_cond_signal(&sleepCond);
+    pthread_mutex_unlock(&sleepLock);
+  }
+}
+
+void cgaJobWait(job_counter_t* counter) {
+  if (counter == null) {
+    return;
+  }
+
+  while (atomic_load_explicit(&counter->pending, memory_order_acquire) > 0) {
+    if (!runOneJob()) {
+      sched_yield();
+    }
+  }
+}
+
+static void runRange(void* arg) {
+  parallel_range_t* range = arg;
+  range->fn(range->start, range->end, range->arg);
+}
+
+void cgaParallelFor(int count, int grainSize, parallel_for_fn_t fn, void* arg) {
+  if (count < 1) {
+    return;
+  }
+
+  if (grainSize < 1) {
+    grainSize = 1;
+  }
+
+  int chunks = (count + grainSize - 1) / grainSize;
+
+  if (chunks == 1 || !atomic_load(&running)) {
+    fn(0, count, arg);
+    return;
+  }
+
+  parallel_range_t* ranges = malloc(sizeof(parallel_range_t) * chunks);
+
+  if (ranges == null) {
+    fn(0, count, arg);
+    return;
+  }
+
+  job_counter_t counter = {0};
+
+  for (int i = 0; i < chunks; i++) {
+    ranges[i].start = i * grainSize;
+    ranges[i].end = ranges[i].start + grainSize < count ? ranges[i].start + grainSize : count;
+    ranges[i].fn = fn;
+    ranges[i].arg = arg;
+
+    cgaJobSubmit(runRange, &ranges[i], &counter);
+  }
+
+  cgaJobWait(&counter);
+  free(ranges);
+}
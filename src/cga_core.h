@@ -1,6 +1,8 @@
 #ifndef CORE_H
 #define CORE_H
 
+#include <stdatomic.h>
+
 #define null ((void*) 0)
 #define true 1
 #define false 0
@@ -9,4 +11,48 @@ typedef char boolean;
 
 char* cgaFormatString(int maxlen, char* format, ...);
 
-#endif // CORE_H
\ No newline at end of file
+// Monotonic time in seconds, for measuring intervals
+double cgaGetTime();
+
+// Sleeps at least this long, often a bit longer depending on the scheduler
+void cgaSleep(double seconds);
+
+// Job system
+//
+// A fixed set of worker threads, each with its own work-stealing deque.
+// Jobs submitted from a worker go to that worker's deque; idle workers
+// steal from the others. The thread that calls cgaJobsInit owns deque 0
+// and runs jobs itself while it waits. Without cgaJobsInit every job runs
+// inline on the submitting thread.
+
+#define JOBS_MAX_WORKERS 64
+#define JOBS_DEQUE_CAPACITY 4096
+
+typedef void (*job_fn_t)(void* arg);
+typedef void (*parallel_for_fn_t)(int start, int end, void* arg);
+
+typedef struct JobCounter {
+  atomic_int pending;
+} job_counter_t;
+
+// Starts the job system with workerCount threads in total, including the
+// calling thread. workerCount < 1 uses the number of hardware threads.
+boolean cgaJobsInit(int workerCount);
+
+void cgaJobsShutdown();
+
+// Number of threads running jobs, 1 if the job system isn't running
+int cgaJobsWorkerCount();
+
+// Queues fn(arg), counter (may be null) is incremented now and decremented
+// once the job has run
+void cgaJobSubmit(job_fn_t fn, void* arg, job_counter_t* counter);
+
+// Runs queued jobs on the calling thread until the counter reaches 0
+void cgaJobWait(job_counter_t* counter);
+
+// Calls fn over [0, count) split into chunks of at most grainSize indices
+// and waits for all of them to finish
+void cgaParallelFor(int count, int grainSize, parallel_for_fn_t fn, void* arg);
+
+#endif // CORE_H
@@ -0,0 +1,69 @@
+#include "cga_frame_stats.h"
+#include <string.h>
+
+void cgaFrameTimesInit(frame_times_t* times, double budget) {
+  memset(times, 0, sizeof(frame_times_t));
+  times->budget = budget;
+}
+
+void cgaFrameTimesPush(frame_times_t* times, double seconds) {
+  times->times[times->head] = seconds;
+  times->head = (times->head + 1) % FRAME_TIMES_CAPACITY;
+
+  if (times->count < FRAME_TIMES_CAPACITY) {
+    times->count++;
+  }
+
+  times->totalFrames++;
+
+  if (seconds > times->budget) {
+    times->totalHitches++;
+  }
+}
+
+double cgaFrameTimesGet(const frame_times_t* times, int age) {
+  int index = times->head - 1 - age;
+  return times->times[(index + FRAME_TIMES_CAPACITY) % FRAME_TIMES_CAPACITY];
+}
+
+// Nearest rank on sorted samples
+static double percentile(const double* sorted, int count, int percent) {
+  int rank = (count * percent + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void cgaFrameTimesCompute(const frame_times_t* times, frame_time_stats_t* stats) {
+  double sorted[FRAME_TIMES_CAPACITY];
+  int count = times->count;
+
+  memset(stats, 0, sizeof(frame_time_stats_t));
+
+  if (count == 0) {
+    return;
+  }
+
+  double sum = 0;
+
+  // Insertion sort, the ring is small and mostly similar values
+  for (int i = 0; i < count; i++) {
+    double value = times->times[i];
+    int j = i;
+
+    sum += value;
+    stats->hitches += value > times->budget;
+
+    while (j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+
+    sorted[j] = value;
+  }
+
+  stats->frames = count;
+  stats->mean = sum / count;
+  stats->p50 = percentile(sorted, count, 50);
+  stats->p95 = percentile(sorted, count, 95);
+  stats->p99 = percentile(sorted, count, 99);
+  stats->max = sorted[count - 1];
+}
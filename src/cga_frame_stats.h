@@ -0,0 +1,47 @@
+#ifndef CGA_FRAME_STATS_H
+#define CGA_FRAME_STATS_H
+
+#include <stdint.h>
+#include "cga_core.h"
+
+// Frame timing
+//
+// The last FRAME_TIMES_CAPACITY frame times in a ring, in seconds. Stats
+// are computed over the ring only, so they show how the game runs right
+// now rather than averaged over the whole session.
+
+#define FRAME_TIMES_CAPACITY 256
+
+typedef struct FrameTimes {
+  double times[FRAME_TIMES_CAPACITY];
+  int head;
+  int count;
+
+  // Frames longer than this are hitches
+  double budget;
+
+  uint64_t totalFrames;
+  uint64_t totalHitches;
+} frame_times_t;
+
+typedef struct FrameTimeStats {
+  int frames;
+  double mean;
+  double p50;
+  double p95;
+  double p99;
+  double max;
+  // Hitches among the frames in the ring
+  int hitches;
+} frame_time_stats_t;
+
+void cgaFrameTimesInit(frame_times_t* times, double budget);
+
+void cgaFrameTimesPush(frame_times_t* times, double seconds);
+
+// age 0 is the latest frame, age must be below times->count
+double cgaFrameTimesGet(const frame_times_t* times, int age);
+
+void cgaFrameTimesCompute(const frame_times_t* times, frame_time_stats_t* stats);
+
+#endif // CGA_FRAME_STATS_H
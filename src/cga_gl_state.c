@@ -0,0 +1,226 @@
+#include "cga_gl_state.h"
+
+// Names never handed out by GL, so the first call always goes through
+#define UNKNOWN_NAME 0xFFFFFFFFu
+#define UNKNOWN_ENUM 0xFFFFFFFFu
+
+typedef enum {
+  CAP_BLEND,
+  CAP_TEXTURE_2D,
+  CAP_COUNT
+} cached_cap_t;
+
+typedef struct {
+  GLuint program;
+  GLuint vertexArray;
+  GLuint arrayBuffer;
+  GLuint uniformBuffer;
+  GLuint texture;
+  // 0 disabled, 1 enabled, -1 unknown
+  int caps[CAP_COUNT];
+  GLenum blendSource;
+  GLenum blendDestination;
+} gl_state_t;
+
+static gl_state_t state;
+static boolean stateValid = false;
+
+static gl_state_stats_t frameStats = {0};
+static gl_state_stats_t lastFrameStats = {0};
+static gl_state_stats_t lastOverlayStats = {0};
+static gl_state_stats_t pausedFrameStats = {0};
+
+void cgaGlStateReset() {
+  state.program = UNKNOWN_NAME;
+  state.vertexArray = UNKNOWN_NAME;
+  state.arrayBuffer = UNKNOWN_NAME;
+  state.uniformBuffer = UNKNOWN_NAME;
+  state.texture = UNKNOWN_NAME;
+  state.blendSource = UNKNOWN_ENUM;
+  state.blendDestination = UNKNOWN_ENUM;
+
+  for (int i = 0; i < CAP_COUNT; i++) {
+    state.caps[i] = -1;
+  }
+
+  stateValid = true;
+}
+
+// Returns true if the call has to be issued and counts it either way
+static boolean changes(GLuint* cached, GLuint value) {
+  if (!stateValid) {
+    cgaGlStateReset();
+  }
+
+  if (*cached == value) {
+    frameStats.elided++;
+    return false;
+  }
+
+  *cached = value;
+  frameStats.issued++;
+  return true;
+}
+
+void cgaGlUseProgram(GLuint program) {
+  if (changes(&state.program, program)) {
+    glUseProgram(program);
+  }
+}
+
+void cgaGlBindVertexArray(GLuint vertexArray) {
+  if (changes(&state.vertexArray, vertexArray)) {
+    glBindVertexArray(vertexArray);
+  }
+}
+
+static GLuint* bufferBinding(GLenum target) {
+  switch (target) {
+    case GL_ARRAY_BUFFER:
+      return &state.arrayBuffer;
+
+    case GL_UNIFORM_BUFFER:
+      return &state.uniformBuffer;
+
+    default:
+      return null;
+  }
+}
+
+void cgaGlBindBuffer(GLenum target, GLuint buffer) {
+  GLuint* cached = bufferBinding(target);
+
+  if (cached == null) {
+    frameStats.issued++;
+    glBindBuffer(target, buffer);
+    return;
+  }
+
+  if (changes(cached, buffer)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void cgaGlBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+  // Indexed bindings aren't cached, only the generic one it overwrites
+  GLuint* cached = bufferBinding(target);
+
+  if (!stateValid) {
+    cgaGlStateReset();
+  }
+
+  if (cached != null) {
+    *cached = buffer;
+  }
+
+  frameStats.issued++;
+  glBindBufferBase(target, index, buffer);
+}
+
+void cgaGlBindTexture(GLuint texture) {
+  if (changes(&state.texture, texture)) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+  }
+}
+
+void cgaGlSetEnabled(GLenum capability, boolean enabled) {
+  int cap = capability == GL_BLEND ? CAP_BLEND : (capability == GL_TEXTURE_2D ? CAP_TEXTURE_2D : -1);
+
+  if (!stateValid) {
+    cgaGlStateReset();
+  }
+
+  if (cap >= 0 && state.caps[cap] == (enabled ? 1 : 0)) {
+    frameStats.elided++;
+    return;
+  }
+
+  if (cap >= 0) {
+    state.caps[cap] = enabled ? 1 : 0;
+  }
+
+  frameStats.issued++;
+
+  if (enabled) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+}
+
+void cgaGlBlendFunc(GLenum source, GLenum destination) {
+  if (!stateValid) {
+    cgaGlStateReset();
+  }
+
+  if (state.blendSource == source && state.blendDestination == destination) {
+    frameStats.elided++;
+    return;
+  }
+
+  state.blendSource = source;
+  state.blendDestination = destination;
+  frameStats.issued++;
+  glBlendFunc(source, destination);
+}
+
+void cgaGlDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  frameStats.drawCalls++;
+  glDrawArrays(mode, first, count);
+}
+
+void cgaGlDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+  frameStats.drawCalls++;
+  glDrawArraysInstanced(mode, first, count, instances);
+}
+
+// Deleting a bound object resets its binding to 0
+static void forget(GLuint* cached, GLuint name) {
+  if (stateValid && *cached == name) {
+    *cached = 0;
+  }
+}
+
+void cgaGlDeleteProgram(GLuint program) {
+  forget(&state.program, program);
+  glDeleteProgram(program);
+}
+
+void cgaGlDeleteVertexArray(GLuint vertexArray) {
+  forget(&state.vertexArray, vertexArray);
+  glDeleteVertexArrays(1, &vertexArray);
+}
+
+void cgaGlDeleteBuffer(GLuint buffer) {
+  forget(&state.arrayBuffer, buffer);
+  forget(&state.uniformBuffer, buffer);
+  glDeleteBuffers(1, &buffer);
+}
+
+void cgaGlDeleteTexture(GLuint texture) {
+  forget(&state.texture, texture);
+  glDeleteTextures(1, &texture);
+}
+
+void cgaGlStateEndFrame() {
+  lastFrameStats = frameStats;
+  frameStats = (gl_state_stats_t) {0};
+}
+
+void cgaGlStateGetStats(gl_state_stats_t* stats) {
+  *stats = lastFrameStats;
+}
+
+void cgaGlStateBeginOverlay() {
+  pausedFrameStats = frameStats;
+  frameStats = (gl_state_stats_t) {0};
+}
+
+void cgaGlStateEndOverlay() {
+  lastOverlayStats = frameStats;
+  frameStats = pausedFrameStats;
+}
+
+void cgaGlStateGetOverlayStats(gl_state_stats_t* stats) {
+  *stats = lastOverlayStats;
+}
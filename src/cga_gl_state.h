@@ -0,0 +1,74 @@
+#ifndef CGA_GL_STATE_H
+#define CGA_GL_STATE_H
+
+#include <GL/glew.h>
+#include "cga_core.h"
+
+// GL state cache
+//
+// Thin wrappers around the GL calls that change bindings and capabilities.
+// Each remembers what it last set and skips calls that wouldn't change
+// anything. Renderers set the state they need before drawing instead of
+// restoring defaults afterwards, so consecutive draws with the same state
+// cost no GL calls. Every wrapped call is counted as issued or elided, and
+// draws as draw calls.
+//
+// The cache only knows about changes made through it. Code that calls GL
+// directly has to call cgaGlStateReset afterwards, objects are deleted
+// through the wrappers below so their names aren't cached past deletion.
+
+typedef struct GlStateStats {
+  int issued;
+  int elided;
+  int drawCalls;
+} gl_state_stats_t;
+
+// Forgets all cached state, e.g. for a new context
+void cgaGlStateReset();
+
+void cgaGlUseProgram(GLuint program);
+
+void cgaGlBindVertexArray(GLuint vertexArray);
+
+// Caches GL_ARRAY_BUFFER and GL_UNIFORM_BUFFER, other targets go straight
+// to GL
+void cgaGlBindBuffer(GLenum target, GLuint buffer);
+
+// Also changes the generic GL_UNIFORM_BUFFER binding
+void cgaGlBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+// GL_TEXTURE_2D on texture unit 0, the only one used
+void cgaGlBindTexture(GLuint texture);
+
+// Caches GL_BLEND and GL_TEXTURE_2D
+void cgaGlSetEnabled(GLenum capability, boolean enabled);
+
+void cgaGlBlendFunc(GLenum source, GLenum destination);
+
+void cgaGlDrawArrays(GLenum mode, GLint first, GLsizei count);
+
+void cgaGlDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+
+void cgaGlDeleteProgram(GLuint program);
+
+void cgaGlDeleteVertexArray(GLuint vertexArray);
+
+void cgaGlDeleteBuffer(GLuint buffer);
+
+void cgaGlDeleteTexture(GLuint texture);
+
+// Moves this frame's counters into cgaGlStateGetStats, called by cgaLoop
+void cgaGlStateEndFrame();
+
+// Counters of the last finished frame
+void cgaGlStateGetStats(gl_state_stats_t* stats);
+
+// Calls between these are counted apart from the frame, like
+// cgaBatchBeginOverlay
+void cgaGlStateBeginOverlay();
+
+void cgaGlStateEndOverlay();
+
+void cgaGlStateGetOverlayStats(gl_state_stats_t* stats);
+
+#endif // CGA_GL_STATE_H
@@ -0,0 +1,91 @@
+#include "cga_gpu_timer.h"
+#include "log.h"
+#include <GL/glew.h>
+#include <stdlib.h>
+
+gpu_timer cgaGpuTimerCreate() {
+  gpu_timer timer = calloc(1, sizeof(gpu_timer_t));
+
+  if (timer == null) {
+    logError("Failed to allocate GPU timer");
+    return null;
+  }
+
+  timer->supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+  timer->latest = -1;
+
+  if (timer->supported) {
+    glGenQueries(GPU_TIMER_LATENCY, timer->queries);
+  }
+
+  return timer;
+}
+
+void cgaGpuTimerFree(gpu_timer timer) {
+  if (timer == null) {
+    return;
+  }
+
+  if (timer->supported) {
+    glDeleteQueries(GPU_TIMER_LATENCY, timer->queries);
+  }
+
+  free(timer);
+}
+
+void cgaGpuTimerBegin(gpu_timer timer) {
+  if (!timer->supported || timer->active) {
+    return;
+  }
+
+  // Every query in the ring is in flight, drop the oldest result
+  if (timer->begun - timer->collected == GPU_TIMER_LATENCY) {
+    timer->collected++;
+  }
+
+  glBeginQuery(GL_TIME_ELAPSED, timer->queries[timer->begun % GPU_TIMER_LATENCY]);
+  timer->active = true;
+}
+
+void cgaGpuTimerEnd(gpu_timer timer) {
+  if (!timer->active) {
+    return;
+  }
+
+  glEndQuery(GL_TIME_ELAPSED);
+  timer->begun++;
+  timer->active = false;
+}
+
+double cgaGpuTimerCollect(gpu_timer timer, boolean wait) {
+  if (!timer->supported || timer->collected == timer->begun) {
+    return -1;
+  }
+
+  GLuint query = timer->queries[timer->collected % GPU_TIMER_LATENCY];
+
+  if (!wait) {
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (!available) {
+      return -1;
+    }
+  }
+
+  GLuint64 elapsed = 0;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+  timer->collected++;
+
+  return elapsed / 1e6;
+}
+
+double cgaGpuTimerLatest(gpu_timer timer) {
+  double ms;
+
+  while ((ms = cgaGpuTimerCollect(timer, false)) >= 0) {
+    timer->latest = ms;
+  }
+
+  return timer->latest;
+}
@@ -0,0 +1,44 @@
+#ifndef CGA_GPU_TIMER_H
+#define CGA_GPU_TIMER_H
+
+#include <stdint.h>
+#include "cga_core.h"
+
+// GPU time of a span of GL commands, measured with GL_TIME_ELAPSED queries.
+// Results are read GPU_TIMER_LATENCY spans later so reading never stalls the
+// pipeline. Needs GL 3.3 or ARB_timer_query, otherwise every result is
+// negative.
+
+#define GPU_TIMER_LATENCY 4
+
+typedef struct GpuTimer {
+  uint32_t queries[GPU_TIMER_LATENCY];
+  // Spans begun so far and spans whose results were collected
+  uint64_t begun;
+  uint64_t collected;
+  double latest;
+  boolean supported;
+  boolean active;
+} gpu_timer_t;
+
+typedef gpu_timer_t* gpu_timer;
+
+gpu_timer cgaGpuTimerCreate();
+
+void cgaGpuTimerFree(gpu_timer timer);
+
+// Spans can't nest, GL allows one GL_TIME_ELAPSED query at a time
+void cgaGpuTimerBegin(gpu_timer timer);
+
+void cgaGpuTimerEnd(gpu_timer timer);
+
+// Milliseconds of the oldest span that wasn't collected yet. Returns a
+// negative value if its result isn't available, unless wait is set.
+double cgaGpuTimerCollect(gpu_timer timer, boolean wait);
+
+// Collects every finished span without waiting and returns the newest one's
+// milliseconds, or the last value returned if none finished since. Negative
+// until the first result arrives.
+double cgaGpuTimerLatest(gpu_timer timer);
+
+#endif // CGA_GPU_TIMER_H
@@ -0,0 +1,90 @@
+#include "cga_layer.h"
+#include "cga_batch.h"
+#include "log.h"
+#include <GL/glew.h>
+#include <stdlib.h>
+
+render_layer cgaLayerCreate() {
+  if (!GLEW_VERSION_3_0 && !GLEW_ARB_framebuffer_object) {
+    return null;
+  }
+
+  render_layer layer = calloc(1, sizeof(render_layer_t));
+
+  if (layer == null) {
+    logError("Failed to allocate render layer");
+    return null;
+  }
+
+  glGenFramebuffers(1, &layer->framebufferId);
+  glGenRenderbuffers(1, &layer->colorBufferId);
+
+  return layer;
+}
+
+void cgaLayerFree(render_layer layer) {
+  if (layer == null) {
+    return;
+  }
+
+  glDeleteFramebuffers(1, &layer->framebufferId);
+  glDeleteRenderbuffers(1, &layer->colorBufferId);
+  free(layer);
+}
+
+boolean cgaLayerIsValid(render_layer layer, int width, int height) {
+  return layer->valid && layer->width == width && layer->height == height;
+}
+
+void cgaLayerInvalidate(render_layer layer) {
+  layer->valid = false;
+}
+
+static void resize(render_layer layer, int width, int height) {
+  glBindRenderbuffer(GL_RENDERBUFFER, layer->colorBufferId);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, layer->colorBufferId);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    logErrorF("Render layer framebuffer incomplete at %ix%i", width, height);
+  }
+
+  layer->width = width;
+  layer->height = height;
+}
+
+void cgaLayerBegin(render_layer layer, int width, int height) {
+  // Quads queued so far belong to the screen
+  cgaBatchFlush();
+
+  glBindFramebuffer(GL_FRAMEBUFFER, layer->framebufferId);
+
+  if (layer->width != width || layer->height != height) {
+    resize(layer, width, height);
+  }
+
+  glViewport(0, 0, width, height);
+  glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void cgaLayerEnd(render_layer layer) {
+  cgaBatchFlush();
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  layer->valid = true;
+}
+
+void cgaLayerBlit(render_layer layer) {
+  cgaBatchFlush();
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, layer->framebufferId);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(
+    0, 0, layer->width, layer->height,
+    0, 0, layer->width, layer->height,
+    GL_COLOR_BUFFER_BIT, GL_NEAREST
+  );
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
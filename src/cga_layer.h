@@ -0,0 +1,41 @@
+#ifndef CGA_LAYER_H
+#define CGA_LAYER_H
+
+#include <stdint.h>
+#include "cga_core.h"
+
+// Retained render layer
+//
+// An offscreen framebuffer that content which rarely changes is drawn into
+// once and then copied to the screen every frame with a single blit. Needs
+// GL 3.0 or ARB_framebuffer_object, cgaLayerCreate returns null otherwise.
+
+typedef struct RenderLayer {
+  uint32_t framebufferId;
+  uint32_t colorBufferId;
+  int width;
+  int height;
+  boolean valid;
+} render_layer_t;
+
+typedef render_layer_t* render_layer;
+
+render_layer cgaLayerCreate();
+
+void cgaLayerFree(render_layer layer);
+
+// False if the contents are stale or were drawn for a different size
+boolean cgaLayerIsValid(render_layer layer, int width, int height);
+
+void cgaLayerInvalidate(render_layer layer);
+
+// Redirects drawing into the layer, resizing and clearing it
+void cgaLayerBegin(render_layer layer, int width, int height);
+
+// Finishes drawing into the layer and marks it valid
+void cgaLayerEnd(render_layer layer);
+
+// Copies the layer over the whole default framebuffer
+void cgaLayerBlit(render_layer layer);
+
+#endif // CGA_LAYER_H
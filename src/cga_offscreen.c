@@ -0,0 +1,163 @@
+#include "cga_offscreen.h"
+#include "log.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLConfig config = null;
+static EGLContext context = EGL_NO_CONTEXT;
+static EGLSurface surface = EGL_NO_SURFACE;
+
+static EGLDisplay openDisplay() {
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+  if (getPlatformDisplay != null) {
+    EGLDisplay surfaceless = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, null);
+
+    if (surfaceless != EGL_NO_DISPLAY && eglInitialize(surfaceless, null, null)) {
+      return surfaceless;
+    }
+  }
+#endif
+
+  EGLDisplay fallback = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+  if (fallback != EGL_NO_DISPLAY && eglInitialize(fallback, null, null)) {
+    return fallback;
+  }
+
+  return EGL_NO_DISPLAY;
+}
+
+static EGLContext createContext(boolean core) {
+  const EGLint coreAttribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+
+  const EGLint legacyAttribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 2,
+    EGL_CONTEXT_MINOR_VERSION, 0,
+    EGL_NONE
+  };
+
+  return eglCreateContext(display, config, EGL_NO_CONTEXT, core ? coreAttribs : legacyAttribs);
+}
+
+static boolean createSurface(int width, int height) {
+  const EGLint attribs[] = {
+    EGL_WIDTH, width,
+    EGL_HEIGHT, height,
+    EGL_NONE
+  };
+
+  surface = eglCreatePbufferSurface(display, config, attribs);
+
+  if (surface == EGL_NO_SURFACE) {
+    logErrorF("Failed to create %ix%i pbuffer, egl error 0x%x", width, height, eglGetError());
+    return false;
+  }
+
+  return eglMakeCurrent(display, surface, surface, context);
+}
+
+boolean cgaOffscreenInit(int width, int height, boolean* core) {
+  display = openDisplay();
+
+  if (display == EGL_NO_DISPLAY) {
+    logError("No EGL display available");
+    return false;
+  }
+
+  const EGLint configAttribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_NONE
+  };
+
+  EGLint configCount = 0;
+
+  if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount < 1) {
+    logError("No EGL config for an OpenGL pbuffer");
+    cgaOffscreenClose();
+    return false;
+  }
+
+  context = *core ? createContext(true) : EGL_NO_CONTEXT;
+
+  if (context == EGL_NO_CONTEXT) {
+    *core = false;
+    context = createContext(false);
+  }
+
+  if (context == EGL_NO_CONTEXT) {
+    logErrorF("Failed to create EGL context, egl error 0x%x", eglGetError());
+    cgaOffscreenClose();
+    return false;
+  }
+
+  if (!createSurface(width, height)) {
+    cgaOffscreenClose();
+    return false;
+  }
+
+  return true;
+}
+
+boolean cgaOffscreenResize(int width, int height) {
+  if (display == EGL_NO_DISPLAY) {
+    return false;
+  }
+
+  EGLSurface old = surface;
+
+  if (!createSurface(width, height)) {
+    surface = old;
+    eglMakeCurrent(display, surface, surface, context);
+    return false;
+  }
+
+  eglDestroySurface(display, old);
+  return true;
+}
+
+boolean cgaOffscreenMakeCurrent(boolean current) {
+  if (display == EGL_NO_DISPLAY) {
+    return false;
+  }
+
+  if (!current) {
+    return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  }
+
+  return eglMakeCurrent(display, surface, surface, context);
+}
+
+void cgaOffscreenClose() {
+  if (display == EGL_NO_DISPLAY) {
+    return;
+  }
+
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+  if (surface != EGL_NO_SURFACE) {
+    eglDestroySurface(display, surface);
+  }
+
+  if (context != EGL_NO_CONTEXT) {
+    eglDestroyContext(display, context);
+  }
+
+  eglTerminate(display);
+
+  display = EGL_NO_DISPLAY;
+  context = EGL_NO_CONTEXT;
+  surface = EGL_NO_SURFACE;
+}
@@ -0,0 +1,25 @@
+#ifndef CGA_OFFSCREEN_H
+#define CGA_OFFSCREEN_H
+
+#include "cga_core.h"
+
+// Headless GL context on an EGL pbuffer, used by cga_window in
+// WINDOW_OFFSCREEN mode. Prefers Mesa's surfaceless platform, so it works
+// without a display or GPU through llvmpipe. Only built where CMake finds
+// EGL, CGA_HAS_EGL is defined then.
+
+// Creates a context and a width x height pbuffer and makes them current.
+// With core set it asks for a 3.3 core profile and falls back to 2.0,
+// *core is updated to what was created.
+boolean cgaOffscreenInit(int width, int height, boolean* core);
+
+// Replaces the pbuffer, pbuffers can't change size
+boolean cgaOffscreenResize(int width, int height);
+
+// Binds the context to the calling thread, or with current false releases
+// it so another thread can take it
+boolean cgaOffscreenMakeCurrent(boolean current);
+
+void cgaOffscreenClose();
+
+#endif // CGA_OFFSCREEN_H
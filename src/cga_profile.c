@@ -0,0 +1,237 @@
+#include "cga_profile.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define PROFILE_TSC
+  #include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+  #define PROFILE_TSC
+  #include <intrin.h>
+#endif
+
+#define PROFILE_RING_MASK (PROFILE_RING_SIZE - 1)
+#define THREAD_NAME_LEN 32
+#define EXPORT_PATH_LEN 256
+#define MIN_CALIBRATION_SECS 0.01
+
+// name == null closes the innermost zone
+typedef struct {
+  uint64_t ticks;
+  const char* name;
+} profile_event_t;
+
+typedef struct ProfileThread {
+  profile_event_t events[PROFILE_RING_SIZE];
+  // Total events recorded, the ring holds the last PROFILE_RING_SIZE
+  atomic_size_t written;
+  int id;
+  char name[THREAD_NAME_LEN];
+  struct ProfileThread* next;
+} profile_thread_t;
+
+static pthread_mutex_t threadsLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t clockOnce = PTHREAD_ONCE_INIT;
+static profile_thread_t* threads = null;
+static int threadCount = 0;
+
+// Ticks are converted to time against these when exporting
+static uint64_t baseTicks = 0;
+static double baseTime = 0;
+
+static char exitPath[EXPORT_PATH_LEN];
+static boolean exitHookInstalled = false;
+
+static _Thread_local profile_thread_t* localThread = null;
+
+static uint64_t readTicks() {
+#ifdef PROFILE_TSC
+  return __rdtsc();
+#else
+  return (uint64_t) (cgaGetTime() * 1e9);
+#endif
+}
+
+static void initClock() {
+  baseTicks = readTicks();
+  baseTime = cgaGetTime();
+}
+
+static profile_thread_t* threadState() {
+  if (localThread != null) {
+    return localThread;
+  }
+
+  pthread_once(&clockOnce, initClock);
+
+  // Events are stored in place, calloc keeps the untouched pages lazy
+  profile_thread_t* thread = calloc(1, sizeof(profile_thread_t));
+
+  if (thread == null) {
+    return null;
+  }
+
+  atomic_init(&thread->written, 0);
+
+  pthread_mutex_lock(&threadsLock);
+  thread->id = ++threadCount;
+  thread->next = threads;
+  threads = thread;
+  pthread_mutex_unlock(&threadsLock);
+
+  localThread = thread;
+  return thread;
+}
+
+static void record(const char* name) {
+  profile_thread_t* thread = threadState();
+
+  if (thread == null) {
+    return;
+  }
+
+  size_t index = atomic_load_explicit(&thread->written, memory_order_relaxed);
+  profile_event_t* event = &thread->events[index & PROFILE_RING_MASK];
+
+  event->ticks = readTicks();
+  event->name = name;
+
+  atomic_store_explicit(&thread->written, index + 1, memory_order_release);
+}
+
+void cgaProfileBegin(const char* name) {
+  record(name);
+}
+
+void cgaProfileEnd() {
+  record(null);
+}
+
+void cgaProfileThreadName(const char* name) {
+  profile_thread_t* thread = threadState();
+
+  if (thread != null) {
+    snprintf(thread->name, THREAD_NAME_LEN, "%s", name);
+  }
+}
+
+static void writeEscaped(FILE* f, const char* str) {
+  for (const char* c = str; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fputc('\\', f);
+      fputc(*c, f);
+    } else if ((unsigned char) *c < 0x20) {
+      fprintf(f, "\\u%04x", *c);
+    } else {
+      fputc(*c, f);
+    }
+  }
+}
+
+// Microseconds per tick, measured over the whole run so far
+static double tickScale() {
+  uint64_t ticks = readTicks();
+  double time = cgaGetTime();
+
+  if (time - baseTime < MIN_CALIBRATION_SECS) {
+    cgaSleep(MIN_CALIBRATION_SECS);
+    ticks = readTicks();
+    time = cgaGetTime();
+  }
+
+  return (time - baseTime) * 1e6 / (double) (ticks - baseTicks);
+}
+
+static void writeThread(FILE* f, const profile_thread_t* thread, double scale, boolean* first) {
+  size_t written = atomic_load_explicit(&thread->written, memory_order_acquire);
+  size_t start = written > PROFILE_RING_SIZE ? written - PROFILE_RING_SIZE : 0;
+  int depth = 0;
+
+  if (thread->name[0] != '\0') {
+    fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"",
+      *first ? "" : ",", thread->id
+    );
+    writeEscaped(f, thread->name);
+    fprintf(f, "\"}}");
+    *first = false;
+  }
+
+  for (size_t i = start; i < written; i++) {
+    const profile_event_t* event = &thread->events[i & PROFILE_RING_MASK];
+    double us = (double) (int64_t) (event->ticks - baseTicks) * scale;
+
+    // The matching begin was overwritten by newer events
+    if (event->name == null && depth == 0) {
+      continue;
+    }
+
+    fprintf(f, "%s\n", *first ? "" : ",");
+    *first = false;
+
+    if (event->name == null) {
+      fprintf(f, "{\"ph\":\"E\",\"pid\":1,\"tid\":%i,\"ts\":%.3f}", thread->id, us);
+      depth--;
+    } else {
+      fprintf(f, "{\"name\":\"");
+      writeEscaped(f, event->name);
+      fprintf(f, "\",\"ph\":\"B\",\"pid\":1,\"tid\":%i,\"ts\":%.3f}", thread->id, us);
+      depth++;
+    }
+  }
+}
+
+boolean cgaProfileExport(const char* path) {
+#ifndef CGA_PROFILE
+  logWarn("Profiler zones are compiled out, configure with -DCGA_PROFILE=ON");
+#endif
+
+  FILE* f = fopen(path, "w");
+
+  if (f == null) {
+    logErrorF("Failed to open profile trace '%s'", path);
+    return false;
+  }
+
+  pthread_once(&clockOnce, initClock);
+
+  double scale = tickScale();
+  boolean first = true;
+
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  pthread_mutex_lock(&threadsLock);
+
+  for (profile_thread_t* thread = threads; thread != null; thread = thread->next) {
+    writeThread(f, thread, scale, &first);
+  }
+
+  pthread_mutex_unlock(&threadsLock);
+
+  fprintf(f, "\n]}\n");
+
+  boolean ok = !ferror(f);
+
+  if (fclose(f) != 0 || !ok) {
+    logErrorF("Failed to write profile trace '%s'", path);
+    return false;
+  }
+
+  logInfoF("Wrote profile trace to %s", path);
+  return true;
+}
+
+static void onExit() {
+  cgaProfileExport(exitPath);
+}
+
+void cgaProfileExportAtExit(const char* path) {
+  snprintf(exitPath, EXPORT_PATH_LEN, "%s", path);
+
+  if (!exitHookInstalled) {
+    atexit(onExit);
+    exitHookInstalled = true;
+  }
+}
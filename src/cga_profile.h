@@ -0,0 +1,46 @@
+#ifndef CGA_PROFILE_H
+#define CGA_PROFILE_H
+
+#include <stdint.h>
+#include "cga_core.h"
+
+// Zone profiler
+//
+// profileBegin/profileEnd mark nested zones on the calling thread. Each
+// thread records into its own ring of PROFILE_RING_SIZE events, keeping
+// the most recent ones, with TSC timestamps where the CPU has one and the
+// monotonic clock otherwise. cgaProfileExport writes every thread's events
+// as Chrome trace-event JSON, open it in chrome://tracing or Perfetto.
+//
+// Zones only exist when built with CGA_PROFILE defined (the CGA_PROFILE
+// CMake option), otherwise the macros expand to nothing. Zone names must
+// outlive the export, string literals in practice.
+
+#define PROFILE_RING_SIZE (64 * 1024)
+
+#ifdef CGA_PROFILE
+  #define profileBegin(name) cgaProfileBegin(name)
+  #define profileEnd() cgaProfileEnd()
+  #define profileThreadName(name) cgaProfileThreadName(name)
+#else
+  #define profileBegin(name) ((void) 0)
+  #define profileEnd() ((void) 0)
+  #define profileThreadName(name) ((void) 0)
+#endif
+
+void cgaProfileBegin(const char* name);
+
+// Closes the innermost open zone of the calling thread
+void cgaProfileEnd();
+
+// Shown instead of the thread number in the trace viewer
+void cgaProfileThreadName(const char* name);
+
+// Best effort while other threads are still recording, their oldest events
+// may be overwritten during the export
+boolean cgaProfileExport(const char* path);
+
+// Exports to path when the process exits
+void cgaProfileExportAtExit(const char* path);
+
+#endif // CGA_PROFILE_H
@@ -0,0 +1,65 @@
+#include "cga_random.h"
+
+static uint64_t splitMix(uint64_t* seed) {
+  uint64_t z = (*seed += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+void cgaRandomSeed(random_t* r, uint64_t seed) {
+  for (int i = 0; i < 4; i++) {
+    r->s[i] = splitMix(&seed);
+  }
+}
+
+void cgaRandomJump(random_t* r) {
+  static const uint64_t JUMP[] = {
+    0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+    0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+  };
+
+  uint64_t s0 = 0;
+  uint64_t s1 = 0;
+  uint64_t s2 = 0;
+  uint64_t s3 = 0;
+
+  for (int i = 0; i < 4; i++) {
+    for (int b = 0; b < 64; b++) {
+      if (JUMP[i] & (1ULL << b)) {
+        s0 ^= r->s[0];
+        s1 ^= r->s[1];
+        s2 ^= r->s[2];
+        s3 ^= r->s[3];
+      }
+
+      cgaRandomNext(r);
+    }
+  }
+
+  r->s[0] = s0;
+  r->s[1] = s1;
+  r->s[2] = s2;
+  r->s[3] = s3;
+}
+
+void cgaRandomStreams(const random_t* base, random_t* out, int count) {
+  random_t current = *base;
+
+  for (int i = 0; i < count; i++) {
+    cgaRandomJump(&current);
+    out[i] = current;
+  }
+}
+
+void cgaRandomFill(random_t* r, uint64_t* out, int count) {
+  for (int i = 0; i < count; i++) {
+    out[i] = cgaRandomNext(r);
+  }
+}
+
+void cgaRandomFillBounded(random_t* r, uint32_t* out, int count, uint32_t bound) {
+  for (int i = 0; i < count; i++) {
+    out[i] = cgaRandomBounded(r, bound);
+  }
+}
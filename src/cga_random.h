@@ -0,0 +1,65 @@
+#ifndef CGA_RANDOM_H
+#define CGA_RANDOM_H
+
+#include <stdint.h>
+
+// xoshiro256** generator. All state is in the struct, so every game or
+// thread can own one and nothing is shared.
+typedef struct Random {
+  uint64_t s[4];
+} random_t;
+
+// Expands a 64-bit seed into the full state with splitmix64, equal seeds
+// always give equal sequences
+void cgaRandomSeed(random_t* r, uint64_t seed);
+
+// Advances the state by 2^128 steps. Jumping a copy of one seeded generator
+// 0, 1, 2... times gives non-overlapping streams for parallel use.
+void cgaRandomJump(random_t* r);
+
+// Writes `count` generators into out, out[i] is base jumped i + 1 times
+void cgaRandomStreams(const random_t* base, random_t* out, int count);
+
+void cgaRandomFill(random_t* r, uint64_t* out, int count);
+
+// Fills out with values in [0, bound)
+void cgaRandomFillBounded(random_t* r, uint32_t* out, int count, uint32_t bound);
+
+static inline uint64_t cgaRotl64(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+// Inline since it sits in the per-move hot path
+static inline uint64_t cgaRandomNext(random_t* r) {
+  uint64_t* s = r->s;
+  uint64_t result = cgaRotl64(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = cgaRotl64(s[3], 45);
+
+  return result;
+}
+
+// Unbiased value in [0, bound) using Lemire's multiply-shift method
+static inline uint32_t cgaRandomBounded(random_t* r, uint32_t bound) {
+  uint64_t m = (cgaRandomNext(r) >> 32) * bound;
+  uint32_t low = (uint32_t) m;
+
+  if (low < bound) {
+    uint32_t threshold = -bound % bound;
+
+    while (low < threshold) {
+      m = (cgaRandomNext(r) >> 32) * bound;
+      low = (uint32_t) m;
+    }
+  }
+
+  return (uint32_t) (m >> 32);
+}
+
+#endif // CGA_RANDOM_H
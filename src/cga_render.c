@@ -1,12 +1,26 @@
 #include "cga_render.h"
 #include "cga_core.h"
+#include "cga_gl_state.h"
 #include "log.h"
 #include <stdlib.h>
 #include <string.h>
 
-#define INITIAL_BUFFER_SIZE 1024
-#define VEC2_SIZE (sizeof(float) * 2)
-#define OFFSET_PTR(buf) (buf->data + buf->length)
+#define PERSISTENT_FLAGS (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+#define FENCE_TIMEOUT_NS 1000000000ull
+#define COMMANDS_INITIAL_CAPACITY 64
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+
+static boolean coreProfile = false;
+
+void cgaSetCoreProfile(boolean core) {
+  coreProfile = core;
+}
+
+boolean cgaIsCoreProfile() {
+  return coreProfile;
+}
 
 vertex_buffer cgaGenVertexBuffer() {
   uint32_t id = 0;
@@ -16,27 +30,15 @@ vertex_buffer cgaGenVertexBuffer() {
     return null;
   }
 
-  int memSize = sizeof(vertex_buffer_t);
-  vertex_buffer ptr = malloc(memSize);
+  vertex_buffer ptr = cgaAllocVertexBuffer(0);
 
   if (ptr == null) {
-    logError("Failed to allocate vertex buffer struct");
+    glDeleteVertexArrays(1, &id);
     return null;
   }
 
-  uint8_t* databuf = malloc(INITIAL_BUFFER_SIZE);
-
-  ptr->length = 0;
   ptr->id = id;
-
-  if (databuf == null) {
-    logError("Failed to allocate array for vertex buffer data");
-    ptr->capacity = 0;
-    ptr->data = null; 
-  } else {
-    ptr->capacity = INITIAL_BUFFER_SIZE;
-    ptr->data = databuf;
-  }
+  glGenBuffers(1, &ptr->bufferId);
 
   return ptr;
 }
@@ -46,98 +48,452 @@ void cgaFreeVertexBuffer(vertex_buffer buf) {
     return;
   }
 
-  if (buf->id != null) {
-    glDeleteVertexArrays(1, &buf->id);
-  }
-
-  if (buf->data != null) {
-    free(buf->data);
-    buf->data = null;
+  if (buf->id != 0) {
+    cgaGlDeleteVertexArray(buf->id);
   }
 
-  free(buf);
-}
-
-void cgaClearBuffer(vertex_buffer buf) {
-  if (buf == null || buf->capacity < 1) {
-    return;
+  if (buf->bufferId != 0) {
+    cgaGlDeleteBuffer(buf->bufferId);
   }
 
-  buf->length = 0;
+  cgaReleaseVertexBuffer(buf);
 }
 
 void cgaBindBuffer(vertex_buffer buf) {
   if (buf == null) {
-    glBindVertexArray(null);
+    cgaGlBindVertexArray(0);
+    cgaGlBindBuffer(GL_ARRAY_BUFFER, 0);
     return;
   }
 
-  glBindVertexArray(buf->id);
+  cgaGlBindVertexArray(buf->id);
+  cgaGlBindBuffer(GL_ARRAY_BUFFER, buf->bufferId);
 }
 
 void cgaUploadBuffer(vertex_buffer buf, GLenum usage) {
   glBufferData(GL_ARRAY_BUFFER, buf->length, buf->data, usage);
 }
 
-static boolean ensureWritable(vertex_buffer buf, int bytesToWrite) {
-  uint32_t cap = buf->capacity;
-  uint32_t len = buf->length;
-  uint32_t nlen = bytesToWrite + len;
+static GLenum attribGlType(vertex_attrib_type_t type) {
+  return type == ATTRIB_U8 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+}
+
+static GLenum attribArray(vertex_attrib_usage_t usage) {
+  switch (usage) {
+    case ATTRIB_TEXCOORD:
+      return GL_TEXTURE_COORD_ARRAY;
+
+    case ATTRIB_COLOR:
+      return GL_COLOR_ARRAY;
+
+    default:
+      return GL_VERTEX_ARRAY;
+  }
+}
 
-  if (nlen <= cap) {
+void cgaEnableVertexLayout(const vertex_layout_t* layout, uintptr_t offset) {
+  for (int i = 0; i < layout->attribCount; i++) {
+    const vertex_attrib_t* attrib = &layout->attribs[i];
+    const void* ptr = (const void*) (offset + attrib->offset);
+    GLenum type = attribGlType(attrib->type);
+
+    if (coreProfile) {
+      // Integer attributes are colours here, normalize them to 0..1
+      GLboolean normalized = attrib->type == ATTRIB_U8 ? GL_TRUE : GL_FALSE;
+
+      glEnableVertexAttribArray(attrib->usage);
+      glVertexAttribPointer(attrib->usage, attrib->components, type, normalized, layout->stride, ptr);
+      continue;
+    }
+
+    glEnableClientState(attribArray(attrib->usage));
+
+    switch (attrib->usage) {
+      case ATTRIB_POSITION:
+        glVertexPointer(attrib->components, type, layout->stride, ptr);
+        break;
+
+      case ATTRIB_TEXCOORD:
+        glTexCoordPointer(attrib->components, type, layout->stride, ptr);
+        break;
+
+      case ATTRIB_COLOR:
+        glColorPointer(attrib->components, type, layout->stride, ptr);
+        break;
+    }
+  }
+}
+
+void cgaDisableVertexLayout(const vertex_layout_t* layout) {
+  for (int i = 0; i < layout->attribCount; i++) {
+    if (coreProfile) {
+      glDisableVertexAttribArray(layout->attribs[i].usage);
+      continue;
+    }
+
+    glDisableClientState(attribArray(layout->attribs[i].usage));
+  }
+}
+
+int64_t cgaStreamVertexBuffer(stream_buffer ring, vertex_buffer buf) {
+  return cgaStreamUpload(ring, buf->data, buf->length);
+}
+
+static boolean supportsPersistentMapping() {
+  if (GLEW_VERSION_4_4) {
     return true;
   }
 
-  uint32_t ncap = ((nlen / INITIAL_BUFFER_SIZE) + 1) * INITIAL_BUFFER_SIZE;
-  uint8_t* nptr = realloc(buf->data, ncap);
+  return GLEW_ARB_buffer_storage && (GLEW_VERSION_3_2 || GLEW_ARB_sync);
+}
 
-  if (nptr == null) {
-    logError("Failed to expand vertex array");
-    return false;
+static boolean initPersistent(stream_buffer ring) {
+  glBufferStorage(GL_ARRAY_BUFFER, ring->capacity, null, PERSISTENT_FLAGS);
+  ring->mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, ring->capacity, PERSISTENT_FLAGS);
+
+  return ring->mapped != null;
+}
+
+stream_buffer cgaGenStreamBuffer(uint32_t capacity) {
+  stream_buffer ring = calloc(1, sizeof(stream_buffer_t));
+
+  if (ring == null) {
+    logError("Failed to allocate stream buffer struct");
+    return null;
+  }
+
+  ring->capacity = capacity;
+  glGenBuffers(1, &ring->bufferId);
+
+  if (ring->bufferId == 0) {
+    free(ring);
+    return null;
+  }
+
+  cgaGlBindBuffer(GL_ARRAY_BUFFER, ring->bufferId);
+
+  if (supportsPersistentMapping() && initPersistent(ring)) {
+    ring->mode = STREAM_MODE_PERSISTENT;
+  } else {
+    // Storage made with glBufferStorage is immutable, start over with a new name
+    if (supportsPersistentMapping()) {
+      logWarn("Persistent mapping failed, stream buffer falls back to orphaning");
+
+      cgaGlDeleteBuffer(ring->bufferId);
+      glGenBuffers(1, &ring->bufferId);
+      cgaGlBindBuffer(GL_ARRAY_BUFFER, ring->bufferId);
+    }
+
+    ring->mode = STREAM_MODE_ORPHAN;
+    ring->mapped = null;
+    glBufferData(GL_ARRAY_BUFFER, ring->capacity, null, GL_STREAM_DRAW);
+  }
+
+  return ring;
+}
+
+void cgaFreeStreamBuffer(stream_buffer ring) {
+  if (ring == null) {
+    return;
+  }
+
+  for (int i = 0; i < ring->fenceCount; i++) {
+    glDeleteSync(ring->fences[(ring->fenceStart + i) % STREAM_MAX_FENCES].sync);
+  }
+
+  if (ring->mapped != null) {
+    cgaGlBindBuffer(GL_ARRAY_BUFFER, ring->bufferId);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+
+  cgaGlDeleteBuffer(ring->bufferId);
+  free(ring);
+}
+
+// Retires the oldest fence. If block is false and the GPU isn't done with it
+// yet, returns false instead of waiting.
+static boolean retireFence(stream_buffer ring, boolean block) {
+  stream_fence_t* fence = &ring->fences[ring->fenceStart];
+  GLenum result = glClientWaitSync(fence->sync, 0, 0);
+
+  if (result == GL_TIMEOUT_EXPIRED) {
+    if (!block) {
+      return false;
+    }
+
+    ring->stats.stalls++;
+
+    do {
+      result = glClientWaitSync(fence->sync, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+    } while (result == GL_TIMEOUT_EXPIRED);
   }
 
-  buf->data = nptr;
-  buf->capacity = ncap;
+  glDeleteSync(fence->sync);
+  ring->released = fence->position;
+  ring->fenceStart = (ring->fenceStart + 1) % STREAM_MAX_FENCES;
+  ring->fenceCount--;
 
   return true;
 }
 
-void cgaPushVertex2f(vertex_buffer buf, float x, float y) {
-  if (!ensureWritable(buf, VEC2_SIZE)) {
+static void placeFence(stream_buffer ring) {
+  if (ring->fenceCount == STREAM_MAX_FENCES) {
+    retireFence(ring, true);
+  }
+
+  int index = (ring->fenceStart + ring->fenceCount) % STREAM_MAX_FENCES;
+  ring->fences[index].sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  ring->fences[index].position = ring->position;
+  ring->fenceCount++;
+}
+
+static int64_t uploadPersistent(stream_buffer ring, const void* data, uint32_t size) {
+  uint32_t offset = (uint32_t) (ring->position % ring->capacity);
+
+  // Allocations never straddle the end of the ring
+  if (offset + size > ring->capacity) {
+    ring->position += ring->capacity - offset;
+    offset = 0;
+  }
+
+  uint64_t end = ring->position + size;
+
+  while (end > ring->released + ring->capacity) {
+    // Wrapped into data written this frame, fence it so there is something
+    // to wait for
+    if (ring->fenceCount == 0) {
+      placeFence(ring);
+    }
+
+    retireFence(ring, true);
+  }
+
+  memcpy(ring->mapped + offset, data, size);
+  ring->position = end;
+
+  return offset;
+}
+
+static int64_t uploadOrphan(stream_buffer ring, const void* data, uint32_t size) {
+  uint32_t offset = (uint32_t) (ring->position % ring->capacity);
+
+  // The driver hands out fresh storage and frees the old one once the GPU
+  // is done with it, so nothing written since the last orphan is ever
+  // overwritten and the mapping can be unsynchronized
+  if (offset + size > ring->capacity) {
+    glBufferData(GL_ARRAY_BUFFER, ring->capacity, null, GL_STREAM_DRAW);
+    ring->position += ring->capacity - offset;
+    ring->stats.orphans++;
+    offset = 0;
+  }
+
+  if (GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range) {
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    void* ptr = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, access);
+
+    if (ptr == null) {
+      return -1;
+    }
+
+    memcpy(ptr, data, size);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  } else {
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+  }
+
+  ring->position += size;
+  return offset;
+}
+
+int64_t cgaStreamUpload(stream_buffer ring, const void* data, uint32_t size) {
+  if (ring == null || size > ring->capacity) {
+    return -1;
+  }
+
+  cgaGlBindBuffer(GL_ARRAY_BUFFER, ring->bufferId);
+
+  int64_t offset = ring->mode == STREAM_MODE_PERSISTENT
+    ? uploadPersistent(ring, data, size)
+    : uploadOrphan(ring, data, size);
+
+  if (offset >= 0) {
+    ring->stats.bytesUploaded += size;
+  }
+
+  return offset;
+}
+
+void cgaStreamEndFrame(stream_buffer ring) {
+  if (ring == null || ring->mode != STREAM_MODE_PERSISTENT) {
     return;
   }
 
-  float* fPtr = (float*) OFFSET_PTR(buf);
-  fPtr[0] = x;
-  fPtr[1] = y;
+  // Drop fences the GPU already passed without waiting on the rest
+  while (ring->fenceCount > 0 && retireFence(ring, false)) {
+  }
+
+  uint64_t fenced = ring->fenceCount > 0
+    ? ring->fences[(ring->fenceStart + ring->fenceCount - 1) % STREAM_MAX_FENCES].position
+    : ring->released;
+
+  if (ring->position > fenced) {
+    placeFence(ring);
+  }
+}
+
+void cgaStreamGetStats(stream_buffer ring, stream_stats_t* stats) {
+  *stats = ring->stats;
+}
+
+command_buffer cgaGenCommandBuffer() {
+  command_buffer cmds = calloc(1, sizeof(command_buffer_t));
+
+  if (cmds == null) {
+    logError("Failed to allocate command buffer struct");
+    return null;
+  }
+
+  cmds->commands = malloc(sizeof(render_command_t) * COMMANDS_INITIAL_CAPACITY);
+  cmds->scratch = malloc(sizeof(render_command_t) * COMMANDS_INITIAL_CAPACITY);
+
+  if (cmds->commands == null || cmds->scratch == null) {
+    logError("Failed to allocate command buffer");
+    cgaFreeCommandBuffer(cmds);
+    return null;
+  }
+
+  cmds->capacity = COMMANDS_INITIAL_CAPACITY;
+  return cmds;
+}
+
+void cgaFreeCommandBuffer(command_buffer cmds) {
+  if (cmds == null) {
+    return;
+  }
 
-  buf->length += VEC2_SIZE;
+  free(cmds->commands);
+  free(cmds->scratch);
+  free(cmds);
 }
 
-#define PUSH_SINGLE_VALUE(type, val, buf) \
-  if (!ensureWritable(buf, sizeof(type))) {\
-    return;\
-  }\
-  type* ptr = (type*) (buf->data + buf->length);\
-  ptr[0] = val;\
-  buf->length += sizeof(type);
+static boolean growCommands(command_buffer cmds) {
+  int capacity = cmds->capacity * 2;
+  render_command_t* commands = realloc(cmds->commands, sizeof(render_command_t) * capacity);
+
+  if (commands == null) {
+    return false;
+  }
+
+  cmds->commands = commands;
+
+  // Scratch contents don't survive between sorts, no need to copy them
+  render_command_t* scratch = malloc(sizeof(render_command_t) * capacity);
+
+  if (scratch == null) {
+    return false;
+  }
 
-void cgaPushF32(vertex_buffer buf, float f) {
-  PUSH_SINGLE_VALUE(float, f, buf)
+  free(cmds->scratch);
+  cmds->scratch = scratch;
+  cmds->capacity = capacity;
+  return true;
 }
-void cgaPushF64(vertex_buffer buf, double d)
- {
-  PUSH_SINGLE_VALUE(double, d, buf)
+
+boolean cgaSubmitCommand(
+  command_buffer cmds, uint64_t key,
+  uint32_t program, uint32_t texture,
+  uint32_t first, uint32_t count
+) {
+  if (cmds->count > 0) {
+    render_command_t* last = &cmds->commands[cmds->count - 1];
+
+    if (last->key == key && last->program == program && last->texture == texture
+      && last->first + last->count == first) {
+      last->count += count;
+      return true;
+    }
+  }
+
+  if (cmds->count == cmds->capacity && !growCommands(cmds)) {
+    logError("Failed to grow command buffer");
+    return false;
+  }
+
+  cmds->commands[cmds->count++] = (render_command_t) {
+    .key = key,
+    .program = program,
+    .texture = texture,
+    .first = first,
+    .count = count
+  };
+
+  return true;
 }
 
-void cgaPushI32(vertex_buffer buf, int32_t i) {
-  PUSH_SINGLE_VALUE(int32_t, i, buf)
+void cgaSortCommands(command_buffer cmds) {
+  int count = cmds->count;
+
+  if (count < 2) {
+    return;
+  }
+
+  // Histograms of every byte in one read over the keys
+  uint32_t histograms[RADIX_PASSES][RADIX_BUCKETS];
+  memset(histograms, 0, sizeof(histograms));
+
+  for (int i = 0; i < count; i++) {
+    uint64_t key = cmds->commands[i].key;
+
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+      histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+  }
+
+  render_command_t* src = cmds->commands;
+  render_command_t* dst = cmds->scratch;
+
+  for (int pass = 0; pass < RADIX_PASSES; pass++) {
+    uint32_t* histogram = histograms[pass];
+    int shift = pass * RADIX_BITS;
+
+    // Every key has the same byte here, the pass wouldn't move anything
+    if (histogram[(src[0].key >> shift) & (RADIX_BUCKETS - 1)] == (uint32_t) count) {
+      continue;
+    }
+
+    uint32_t offsets[RADIX_BUCKETS];
+    uint32_t sum = 0;
+
+    for (int b = 0; b < RADIX_BUCKETS; b++) {
+      offsets[b] = sum;
+      sum += histogram[b];
+    }
+
+    for (int i = 0; i < count; i++) {
+      dst[offsets[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+    }
+
+    render_command_t* swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  cmds->commands = src;
+  cmds->scratch = dst;
 }
 
-void cgaPushU32(vertex_buffer buf, uint32_t i) {
-  PUSH_SINGLE_VALUE(uint32_t, i, buf)
+int cgaCommandRunLength(command_buffer cmds, int start) {
+  const render_command_t* first = &cmds->commands[start];
+  int end = start + 1;
+
+  while (end < cmds->count && cmds->commands[end].program == first->program
+    && cmds->commands[end].texture == first->texture) {
+    end++;
+  }
+
+  return end - start;
 }
 
-void cgaPushU8(vertex_buffer buf, uint8_t u8) {
-  PUSH_SINGLE_VALUE(uint8_t, u8, buf)
+void cgaClearCommands(command_buffer cmds) {
+  cmds->count = 0;
 }
@@ -3,15 +3,108 @@
 
 #include <GL/glew.h>
 #include <stdint.h>
+#include "cga_vertex.h"
 
-typedef struct VertexBuffer {
-  uint32_t id;
+// Streaming ring
+//
+// A single large GL buffer that per-frame vertex data is suballocated from,
+// so uploads never reallocate the buffer or wait on the previous frame.
+// With GL 4.4 or ARB_buffer_storage the ring is persistently mapped and
+// fences guard the regions the GPU may still read. Older contexts orphan the
+// buffer whenever the ring wraps and write through glMapBufferRange.
+
+#define STREAM_MAX_FENCES 8
+
+typedef enum {
+  STREAM_MODE_PERSISTENT,
+  STREAM_MODE_ORPHAN
+} stream_mode_t;
+
+typedef struct StreamStats {
+  uint64_t bytesUploaded;
+  // Uploads that had to wait for the GPU to release ring space
+  uint32_t stalls;
+  uint32_t orphans;
+} stream_stats_t;
+
+typedef struct StreamFence {
+  GLsync sync;
+  // Ring position the fence was placed at
+  uint64_t position;
+} stream_fence_t;
+
+typedef struct StreamBuffer {
+  uint32_t bufferId;
   uint32_t capacity;
-  uint32_t length;
-  uint8_t* data;
-} vertex_buffer_t;
+  stream_mode_t mode;
+  uint8_t* mapped;
+
+  // Total bytes written, the write offset is position % capacity
+  uint64_t position;
+  // Everything before this position is no longer read by the GPU
+  uint64_t released;
+
+  stream_fence_t fences[STREAM_MAX_FENCES];
+  int fenceStart;
+  int fenceCount;
+
+  stream_stats_t stats;
+} stream_buffer_t;
+
+typedef stream_buffer_t* stream_buffer;
+
+// Render command buffer
+//
+// Draws are recorded as commands tagged with a 64-bit sort key instead of
+// being issued in call order. cgaSortCommands radix sorts them by key, so
+// the layer decides what's drawn over what, and within a layer commands
+// sharing program and texture end up next to each other where they can be
+// merged into one draw call. The sort is stable, commands with equal keys
+// keep their submission order.
+//
+// Key bits from high to low: layer 8, program 8, texture 16, colour 16,
+// depth 16. Program and texture names are truncated in the key, commands
+// keep the full names for deciding what can be merged.
+
+#define RENDER_KEY_LAYER_SHIFT 56
+#define RENDER_KEY_PROGRAM_SHIFT 48
+#define RENDER_KEY_TEXTURE_SHIFT 32
+#define RENDER_KEY_COLOR_SHIFT 16
+
+#define RENDER_KEY(layer, program, texture, color, depth) ( \
+  ((uint64_t) ((layer) & 0xFF) << RENDER_KEY_LAYER_SHIFT) | \
+  ((uint64_t) ((program) & 0xFF) << RENDER_KEY_PROGRAM_SHIFT) | \
+  ((uint64_t) ((texture) & 0xFFFF) << RENDER_KEY_TEXTURE_SHIFT) | \
+  ((uint64_t) ((color) & 0xFFFF) << RENDER_KEY_COLOR_SHIFT) | \
+  (uint64_t) ((depth) & 0xFFFF))
 
-typedef vertex_buffer_t* vertex_buffer;
+// RGBA8 packed to the 16 key bits as RGB565, alpha is left out
+#define RENDER_KEY_COLOR(r, g, b) ((((r) >> 3) << 11) | (((g) >> 2) << 5) | ((b) >> 3))
+
+typedef struct RenderCommand {
+  uint64_t key;
+  uint32_t program;
+  uint32_t texture;
+  // Vertex range in the submitter's vertex data
+  uint32_t first;
+  uint32_t count;
+} render_command_t;
+
+typedef struct CommandBuffer {
+  render_command_t* commands;
+  // Other half of the radix sort's ping-pong
+  render_command_t* scratch;
+  int count;
+  int capacity;
+} command_buffer_t;
+
+typedef command_buffer_t* command_buffer;
+
+// Set by cgaInit. Core profile contexts have no fixed function pipeline,
+// renderers draw with shaders then.
+void cgaSetCoreProfile(boolean core);
+
+boolean cgaIsCoreProfile();
 
 vertex_buffer cgaGenVertexBuffer();
 
@@ -21,18 +114,53 @@ void cgaBindBuffer(vertex_buffer buf);
 
 void cgaUploadBuffer(vertex_buffer buf, GLenum usage);
 
-void cgaClearBuffer(vertex_buffer buf);
+// Uploads the CPU side data of buf into the ring, leaves the ring's buffer
+// bound to GL_ARRAY_BUFFER and returns the byte offset the data starts at,
+// or -1 if it doesn't fit
+int64_t cgaStreamVertexBuffer(stream_buffer ring, vertex_buffer buf);
+
+// Points the fixed function client arrays, or in a core profile the
+// attribute locations, at a layout in the bound GL_ARRAY_BUFFER, starting
+// `offset` bytes in
+void cgaEnableVertexLayout(const vertex_layout_t* layout, uintptr_t offset);
+
+void cgaDisableVertexLayout(const vertex_layout_t* layout);
+
+stream_buffer cgaGenStreamBuffer(uint32_t capacity);
+
+void cgaFreeStreamBuffer(stream_buffer ring);
+
+// Copies size bytes into the ring, see cgaStreamVertexBuffer
+int64_t cgaStreamUpload(stream_buffer ring, const void* data, uint32_t size);
+
+// Fences everything written so far, call once per frame after the draws
+// that read from the ring were issued
+void cgaStreamEndFrame(stream_buffer ring);
+
+void cgaStreamGetStats(stream_buffer ring, stream_stats_t* stats);
 
-void cgaPushVertex2f(vertex_buffer buf, float x, float y);
+command_buffer cgaGenCommandBuffer();
 
-void cgaPushF32(vertex_buffer buf, float f);
+void cgaFreeCommandBuffer(command_buffer cmds);
 
-void cgaPushF64(vertex_buffer buf, double d);
+// Records `count` vertices starting at `first`. Extends the last command
+// instead when it has the same key and state and its range ends at `first`.
+// Returns false if the buffer can't grow.
+boolean cgaSubmitCommand(
+  command_buffer cmds, uint64_t key,
+  uint32_t program, uint32_t texture,
+  uint32_t first, uint32_t count
+);
 
-void cgaPushI32(vertex_buffer buf, int32_t i);
+// Orders the commands by key, least significant byte first. Bytes every
+// key shares are skipped, so a frame that only uses a few layers and one
+// texture sorts in two or three passes.
+void cgaSortCommands(command_buffer cmds);
 
-void cgaPushU32(vertex_buffer buf, uint32_t i);
+// Number of commands from `start` on that can be drawn as one, those with
+// the same program and texture
+int cgaCommandRunLength(command_buffer cmds, int start);
 
-void cgaPushU8(vertex_buffer buf, uint8_t u8);
+void cgaClearCommands(command_buffer cmds);
 
 #endif // CGA_RENDER_H
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "cga_shader.h"
+#include "cga_core.h"
+#include "cga_gl_state.h"
+#include "log.h"
+
+#define INFO_LOG_SIZE 1024
+
+static GLuint compileShader(GLenum type, const char* source) {
+  GLuint shader = glCreateShader(type);
+
+  if (shader == 0) {
+    return 0;
+  }
+
+  glShaderSource(shader, 1, &source, null);
+  glCompileShader(shader);
+
+  GLint status = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+  if (status != GL_TRUE) {
+    char infoLog[INFO_LOG_SIZE];
+    glGetShaderInfoLog(shader, INFO_LOG_SIZE, null, infoLog);
+
+    logErrorF("%s shader failed to compile: %s", type == GL_VERTEX_SHADER ? "Vertex" : "Fragment", infoLog);
+    glDeleteShader(shader);
+    return 0;
+  }
+
+  return shader;
+}
+
+GLuint cgaCreateProgram(const char* vertexSource, const char* fragmentSource) {
+  GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSource);
+  GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+
+  if (vertex == 0 || fragment == 0) {
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex);
+  glAttachShader(program, fragment);
+  glLinkProgram(program);
+
+  // Flagged for deletion, freed together with the program
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+
+  GLint status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+  if (status != GL_TRUE) {
+    char infoLog[INFO_LOG_SIZE];
+    glGetProgramInfoLog(program, INFO_LOG_SIZE, null, infoLog);
+
+    logErrorF("Shader program failed to link: %s", infoLog);
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  return program;
+}
+
+void cgaFreeProgram(GLuint program) {
+  if (program != 0) {
+    cgaGlDeleteProgram(program);
+  }
+}
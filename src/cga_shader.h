@@ -0,0 +1,11 @@
+#ifndef CGA_SHADER_H
+#define CGA_SHADER_H
+
+#include <GL/glew.h>
+
+// Compiles and links a program, returns 0 and logs the info log on failure
+GLuint cgaCreateProgram(const char* vertexSource, const char* fragmentSource);
+
+void cgaFreeProgram(GLuint program);
+
+#endif // CGA_SHADER_H
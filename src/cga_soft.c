@@ -0,0 +1,377 @@
+#include "cga_soft.h"
+#include "font_glyphs.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+  #define SOFT_X86
+  #include <emmintrin.h>
+#endif
+
+// AVX2 is compiled per function so the rest of the build stays baseline x86
+#if defined(SOFT_X86) && defined(__GNUC__)
+  #define SOFT_AVX2
+  #define SOFT_TARGET(isa) __attribute__((target(isa)))
+  #include <immintrin.h>
+#else
+  #define SOFT_TARGET(isa)
+#endif
+
+#define SOFT_INITIAL_QUADS 256
+#define ENDCHAR '\0'
+
+typedef void (*span_fill_fn_t)(uint32_t* dst, int count, uint32_t color);
+
+typedef struct {
+  soft_target target;
+  span_fill_fn_t fill;
+} raster_job_t;
+
+static uint32_t packColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+  uint8_t bytes[4] = {r, g, b, a};
+  uint32_t color;
+  memcpy(&color, bytes, sizeof(color));
+  return color;
+}
+
+static void fillSpanScalar(uint32_t* dst, int count, uint32_t color) {
+  for (int i = 0; i < count; i++) {
+    dst[i] = color;
+  }
+}
+
+// Spans of 4 or more pixels end with one store that may overlap the previous
+// one, so there is no scalar tail. Glyph runs are short, aligning the start
+// would cost more than the unaligned stores do.
+#ifdef SOFT_X86
+SOFT_TARGET("sse2")
+static void fillSpanSse2(uint32_t* dst, int count, uint32_t color) {
+  if (count < 4) {
+    fillSpanScalar(dst, count, color);
+    return;
+  }
+
+  __m128i value = _mm_set1_epi32((int) color);
+
+  for (int i = 0; i < count - 4; i += 4) {
+    _mm_storeu_si128((__m128i*) (dst + i), value);
+  }
+
+  _mm_storeu_si128((__m128i*) (dst + count - 4), value);
+}
+#endif
+
+#ifdef SOFT_AVX2
+SOFT_TARGET("avx2")
+static void fillSpanAvx2(uint32_t* dst, int count, uint32_t color) {
+  if (count < 8) {
+    fillSpanSse2(dst, count, color);
+    return;
+  }
+
+  __m256i value = _mm256_set1_epi32((int) color);
+  int i = 0;
+
+  for (; i + 16 < count; i += 16) {
+    _mm256_storeu_si256((__m256i*) (dst + i), value);
+    _mm256_storeu_si256((__m256i*) (dst + i + 8), value);
+  }
+
+  if (i + 8 < count) {
+    _mm256_storeu_si256((__m256i*) (dst + i), value);
+  }
+
+  _mm256_storeu_si256((__m256i*) (dst + count - 8), value);
+}
+#endif
+
+static boolean fillSupported(soft_fill_t fill) {
+  switch (fill) {
+    case SOFT_FILL_SSE2:
+#if defined(SOFT_X86) && defined(__GNUC__)
+      return __builtin_cpu_supports("sse2") != 0;
+#elif defined(SOFT_X86)
+      return true;
+#else
+      return false;
+#endif
+
+    case SOFT_FILL_AVX2:
+#ifdef SOFT_AVX2
+      return __builtin_cpu_supports("avx2") != 0;
+#else
+      return false;
+#endif
+
+    default:
+      return true;
+  }
+}
+
+static span_fill_fn_t fillFunction(soft_fill_t fill) {
+  switch (fill) {
+#ifdef SOFT_AVX2
+    case SOFT_FILL_AVX2:
+      return fillSpanAvx2;
+#endif
+
+#ifdef SOFT_X86
+    case SOFT_FILL_SSE2:
+      return fillSpanSse2;
+#endif
+
+    default:
+      return fillSpanScalar;
+  }
+}
+
+soft_fill_t cgaSoftBestFill() {
+  if (fillSupported(SOFT_FILL_AVX2)) {
+    return SOFT_FILL_AVX2;
+  }
+
+  if (fillSupported(SOFT_FILL_SSE2)) {
+    return SOFT_FILL_SSE2;
+  }
+
+  return SOFT_FILL_SCALAR;
+}
+
+soft_target cgaSoftCreate(int width, int height) {
+  if (width < 1 || height < 1) {
+    return null;
+  }
+
+  soft_target target = calloc(1, sizeof(soft_target_t));
+
+  if (target == null) {
+    logError("Failed to allocate software target struct");
+    return null;
+  }
+
+  target->pixels = malloc(sizeof(uint32_t) * width * height);
+  target->quads = malloc(sizeof(soft_quad_t) * SOFT_INITIAL_QUADS);
+
+  if (target->pixels == null || target->quads == null) {
+    logErrorF("Failed to allocate %ix%i software framebuffer", width, height);
+    cgaSoftFree(target);
+    return null;
+  }
+
+  target->width = width;
+  target->height = height;
+  target->quadCapacity = SOFT_INITIAL_QUADS;
+  target->color = packColor(255, 255, 255, 255);
+  target->textXScale = 1;
+  target->textYScale = 1;
+  target->fill = cgaSoftBestFill();
+
+  return target;
+}
+
+void cgaSoftFree(soft_target target) {
+  if (target == null) {
+    return;
+  }
+
+  free(target->pixels);
+  free(target->quads);
+  free(target);
+}
+
+void cgaSoftSetFill(soft_target target, soft_fill_t fill) {
+  target->fill = fillSupported(fill) ? fill : cgaSoftBestFill();
+}
+
+void cgaSoftSetBandRows(soft_target target, int rows) {
+  target->bandRows = rows > 0 ? rows : 0;
+}
+
+void cgaSoftClear(soft_target target, uint8_t r, uint8_t g, uint8_t b) {
+  // Quads recorded before the clear would be overwritten anyway
+  target->quadCount = 0;
+  target->clearPending = true;
+  target->clearColor = packColor(r, g, b, 255);
+}
+
+void cgaSoftSetColor4ub(soft_target target, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+  target->color = packColor(r, g, b, a);
+}
+
+void cgaSoftSetColor3ub(soft_target target, uint8_t r, uint8_t g, uint8_t b) {
+  cgaSoftSetColor4ub(target, r, g, b, 255);
+}
+
+static int clampInt(int v, int lo, int hi) {
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+void cgaSoftFillRect(soft_target target, int x0, int y0, int x1, int y1) {
+  x0 = clampInt(x0, 0, target->width);
+  x1 = clampInt(x1, 0, target->width);
+  y0 = clampInt(y0, 0, target->height);
+  y1 = clampInt(y1, 0, target->height);
+
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  if (target->quadCount == target->quadCapacity) {
+    int capacity = target->quadCapacity * 2;
+    soft_quad_t* nptr = realloc(target->quads, sizeof(soft_quad_t) * capacity);
+
+    if (nptr == null) {
+      logError("Failed to grow software quad list");
+      return;
+    }
+
+    target->quads = nptr;
+    target->quadCapacity = capacity;
+  }
+
+  target->quads[target->quadCount++] = (soft_quad_t) {x0, y0, x1, y1, target->color};
+}
+
+// Pixels whose centre lies inside [a, b), like GL's fill rule
+static int pixelEdge(float p) {
+  float edge = p - 0.5f;
+  int rounded = (int) edge;
+
+  // Truncation already rounds negatives up
+  return rounded + (edge > rounded);
+}
+
+void cgaSoftQuad(soft_target target, float startX, float startY, float endX, float endY) {
+  float minX = startX < endX ? startX : endX;
+  float maxX = startX < endX ? endX : startX;
+  float minY = startY < endY ? startY : endY;
+  float maxY = startY < endY ? endY : startY;
+
+  // y points up, rows are stored top first
+  cgaSoftFillRect(target,
+    pixelEdge((minX + 1) * 0.5f * target->width),
+    pixelEdge((1 - maxY) * 0.5f * target->height),
+    pixelEdge((maxX + 1) * 0.5f * target->width),
+    pixelEdge((1 - minY) * 0.5f * target->height)
+  );
+}
+
+void cgaSoftSetTextScale(soft_target target, float xScale, float yScale) {
+  target->textXScale = xScale;
+  target->textYScale = yScale;
+}
+
+static void softGlyph(soft_target target, int glyph, float chx, float chy, float sizex, float sizey) {
+  const char* bitmap = font8x8_basic[glyph];
+
+  for (int y = 0; y < CHAR_SIZE; y++) {
+    int x = 0;
+
+    while (x < CHAR_SIZE) {
+      if (!(bitmap[y] & (1 << x))) {
+        x++;
+        continue;
+      }
+
+      int runStart = x;
+
+      while (x < CHAR_SIZE && (bitmap[y] & (1 << x))) {
+        x++;
+      }
+
+      cgaSoftQuad(target,
+        chx + runStart * sizex, chy - y * sizey,
+        chx + x * sizex, chy - (y + 1) * sizey
+      );
+    }
+  }
+}
+
+void cgaSoftText(soft_target target, float x, float y, int maxBufSize, const char* content) {
+  const float sizex = CH_BASE_X_SCALE * target->textXScale;
+  const float sizey = CH_BASE_Y_SCALE * target->textYScale;
+
+  float charX = x;
+  float charY = y;
+
+  for (int i = 0; i < maxBufSize; i++) {
+    char ch = content[i];
+
+    if (ch == ENDCHAR) {
+      break;
+    }
+
+    if (ch == '\n' || ch == '\r') {
+      charX = x;
+      charY -= CHAR_DIF_Y * sizey;
+      continue;
+    }
+
+    int glyph = (unsigned char) ch;
+
+    if (glyph < CHARS) {
+      softGlyph(target, glyph, charX, charY, sizex, sizey);
+    }
+
+    charX += CHAR_DIF_X * sizex;
+  }
+}
+
+static void rasterRows(soft_target target, span_fill_fn_t fill, int rowStart, int rowEnd) {
+  uint32_t* pixels = target->pixels;
+  int width = target->width;
+
+  if (target->clearPending) {
+    // Full width rows are contiguous, one span for the whole band
+    fill(pixels + (size_t) rowStart * width, (rowEnd - rowStart) * width, target->clearColor);
+  }
+
+  for (int i = 0; i < target->quadCount; i++) {
+    const soft_quad_t* quad = &target->quads[i];
+    int y0 = quad->y0 > rowStart ? quad->y0 : rowStart;
+    int y1 = quad->y1 < rowEnd ? quad->y1 : rowEnd;
+    int count = quad->x1 - quad->x0;
+
+    for (int y = y0; y < y1; y++) {
+      fill(pixels + (size_t) y * width + quad->x0, count, quad->color);
+    }
+  }
+}
+
+static void rasterBands(int start, int end, void* arg) {
+  raster_job_t* job = arg;
+  soft_target target = job->target;
+
+  for (int band = start; band < end; band++) {
+    int rowStart = band * target->bandRows;
+    int rowEnd = clampInt(rowStart + target->bandRows, 0, target->height);
+
+    rasterRows(target, job->fill, rowStart, rowEnd);
+  }
+}
+
+void cgaSoftFlush(soft_target target) {
+  span_fill_fn_t fill = fillFunction(target->fill);
+  uint64_t filled = target->clearPending ? (uint64_t) target->width * target->height : 0;
+
+  for (int i = 0; i < target->quadCount; i++) {
+    const soft_quad_t* quad = &target->quads[i];
+    filled += (uint64_t) (quad->x1 - quad->x0) * (quad->y1 - quad->y0);
+  }
+
+  // Bands own disjoint rows, each walks every quad in submission order so
+  // overlapping quads still draw back to front
+  if (target->bandRows > 0 && cgaJobsWorkerCount() > 1) {
+    raster_job_t job = {target, fill};
+    int bands = (target->height + target->bandRows - 1) / target->bandRows;
+
+    cgaParallelFor(bands, 1, rasterBands, &job);
+  } else {
+    rasterRows(target, fill, 0, target->height);
+  }
+
+  target->pixelsFilled += filled;
+  target->quadCount = 0;
+  target->clearPending = false;
+}
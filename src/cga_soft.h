@@ -0,0 +1,88 @@
+#ifndef CGA_SOFT_H
+#define CGA_SOFT_H
+
+#include <stdint.h>
+#include "cga_core.h"
+
+// Software rasteriser
+//
+// Draws axis-aligned solid-colour quads and 8x8 bitmap text into an RGBA8
+// framebuffer without any GL. Coordinates are the same -1..1 space with y
+// up that drawQuad and cgaDrawText use, text follows the cgaDrawText layout
+// rules and is drawn like TEXT_MODE_PIXELS. Quads are recorded and only
+// rasterised by cgaSoftFlush, which can split the framebuffer into bands of
+// rows that are filled in parallel through cgaParallelFor.
+
+typedef enum {
+  SOFT_FILL_SCALAR,
+  SOFT_FILL_SSE2,
+  SOFT_FILL_AVX2
+} soft_fill_t;
+
+// Pixel rect, end exclusive
+typedef struct SoftQuad {
+  int x0;
+  int y0;
+  int x1;
+  int y1;
+  uint32_t color;
+} soft_quad_t;
+
+typedef struct SoftTarget {
+  int width;
+  int height;
+  // width * height pixels, top row first, bytes in R G B A order
+  uint32_t* pixels;
+
+  soft_quad_t* quads;
+  int quadCount;
+  int quadCapacity;
+
+  boolean clearPending;
+  uint32_t clearColor;
+  uint32_t color;
+  float textXScale;
+  float textYScale;
+
+  soft_fill_t fill;
+  // Rows per parallel band, 0 rasterises on the calling thread
+  int bandRows;
+
+  // Pixels written by cgaSoftFlush, including the clear
+  uint64_t pixelsFilled;
+} soft_target_t;
+
+typedef soft_target_t* soft_target;
+
+soft_target cgaSoftCreate(int width, int height);
+
+void cgaSoftFree(soft_target target);
+
+// Best span fill the CPU supports, the default for new targets
+soft_fill_t cgaSoftBestFill();
+
+// Falls back to the best supported fill if the CPU lacks the requested one
+void cgaSoftSetFill(soft_target target, soft_fill_t fill);
+
+void cgaSoftSetBandRows(soft_target target, int rows);
+
+void cgaSoftClear(soft_target target, uint8_t r, uint8_t g, uint8_t b);
+
+void cgaSoftSetColor4ub(soft_target target, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+void cgaSoftSetColor3ub(soft_target target, uint8_t r, uint8_t g, uint8_t b);
+
+// Same corners as drawQuad, in either order
+void cgaSoftQuad(soft_target target, float startX, float startY, float endX, float endY);
+
+void cgaSoftFillRect(soft_target target, int x0, int y0, int x1, int y1);
+
+void cgaSoftSetTextScale(soft_target target, float xScale, float yScale);
+
+// Same layout as cgaDrawText, one quad per horizontal run of set glyph pixels
+void cgaSoftText(soft_target target, float x, float y, int maxBufSize, const char* content);
+
+// Rasterises the pending clear and quads into pixels
+void cgaSoftFlush(soft_target target);
+
+#endif // CGA_SOFT_H
@@ -0,0 +1,87 @@
+#include "cga_triple_buffer.h"
+#include "log.h"
+#include <stdlib.h>
+
+#define TRIPLE_BUFFER_FRESH 4u
+#define TRIPLE_BUFFER_INDEX 3u
+
+triple_buffer cgaGenTripleBuffer(size_t slotSize) {
+  triple_buffer tb = calloc(1, sizeof(triple_buffer_t));
+
+  if (tb == null) {
+    logError("Failed to allocate triple buffer struct");
+    return null;
+  }
+
+  tb->slots = calloc(3, slotSize);
+
+  if (tb->slots == null) {
+    logError("Failed to allocate triple buffer slots");
+    free(tb);
+    return null;
+  }
+
+  tb->slotSize = slotSize;
+  tb->back = 0;
+  tb->front = 2;
+  atomic_init(&tb->middle, 1);
+  atomic_init(&tb->published, 0);
+  atomic_init(&tb->skipped, 0);
+
+  return tb;
+}
+
+void cgaFreeTripleBuffer(triple_buffer tb) {
+  if (tb == null) {
+    return;
+  }
+
+  free(tb->slots);
+  free(tb);
+}
+
+static void* slot(triple_buffer tb, unsigned index) {
+  return tb->slots + tb->slotSize * index;
+}
+
+void* cgaTripleBufferBack(triple_buffer tb) {
+  return slot(tb, tb->back);
+}
+
+boolean cgaTripleBufferPublish(triple_buffer tb) {
+  // Release makes the slot's contents visible with the index, acquire
+  // orders the reader's last reads of the returned slot before our writes
+  unsigned previous = atomic_exchange_explicit(&tb->middle, tb->back | TRIPLE_BUFFER_FRESH, memory_order_acq_rel);
+
+  tb->back = previous & TRIPLE_BUFFER_INDEX;
+  atomic_fetch_add_explicit(&tb->published, 1, memory_order_relaxed);
+
+  if ((previous & TRIPLE_BUFFER_FRESH) != 0) {
+    atomic_fetch_add_explicit(&tb->skipped, 1, memory_order_relaxed);
+    return true;
+  }
+
+  return false;
+}
+
+const void* cgaTripleBufferLatest(triple_buffer tb, boolean* fresh) {
+  boolean swapped = false;
+
+  if ((atomic_load_explicit(&tb->middle, memory_order_relaxed) & TRIPLE_BUFFER_FRESH) != 0) {
+    unsigned previous = atomic_exchange_explicit(&tb->middle, tb->front, memory_order_acq_rel);
+
+    tb->front = previous & TRIPLE_BUFFER_INDEX;
+    tb->hasFront = true;
+    swapped = true;
+  }
+
+  if (fresh != null) {
+    *fresh = swapped;
+  }
+
+  return tb->hasFront ? slot(tb, tb->front) : null;
+}
+
+boolean cgaTripleBufferHasFresh(triple_buffer tb) {
+  return (atomic_load_explicit(&tb->middle, memory_order_acquire) & TRIPLE_BUFFER_FRESH) != 0;
+}
@@ -0,0 +1,57 @@
+#ifndef CGA_TRIPLE_BUFFER_H
+#define CGA_TRIPLE_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cga_core.h"
+
+// Triple buffer
+//
+// Hands the latest of a stream of fixed size values from one writer thread
+// to one reader thread without locks or waiting. The writer fills its back
+// slot and publishes it, which swaps it with the middle slot in a single
+// atomic exchange. The reader swaps its front slot with the middle one when
+// that holds something newer. Values the reader didn't get to in time are
+// overwritten, the reader always sees the newest one.
+
+typedef struct TripleBuffer {
+  uint8_t* slots;
+  size_t slotSize;
+
+  // Index of the middle slot, with TRIPLE_BUFFER_FRESH set while it holds
+  // a value the reader hasn't taken
+  atomic_uint middle;
+  // Owned by the writer and the reader
+  unsigned back;
+  unsigned front;
+  boolean hasFront;
+
+  // Written by the writer only, read from anywhere
+  atomic_uint_fast64_t published;
+  // Published values that were replaced before the reader took them
+  atomic_uint_fast64_t skipped;
+} triple_buffer_t;
+
+typedef triple_buffer_t* triple_buffer;
+
+// Three zeroed slots of slotSize bytes
+triple_buffer cgaGenTripleBuffer(size_t slotSize);
+
+void cgaFreeTripleBuffer(triple_buffer tb);
+
+// The writer's slot, valid until the next publish
+void* cgaTripleBufferBack(triple_buffer tb);
+
+// Makes the back slot the newest value. Returns true if this replaced a
+// value the reader never took, which is then the new back slot.
+boolean cgaTripleBufferPublish(triple_buffer tb);
+
+// Newest published value for the reader, valid until its next call, or
+// null if nothing was published yet. fresh (may be null) is set when it
+// differs from what the previous call returned.
+const void* cgaTripleBufferLatest(triple_buffer tb, boolean* fresh);
+
+// True while a published value waits for the reader, from any thread
+boolean cgaTripleBufferHasFresh(triple_buffer tb);
+
+#endif // CGA_TRIPLE_BUFFER_H
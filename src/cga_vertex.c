@@ -0,0 +1,186 @@
+#include "cga_vertex.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_BUFFER_SIZE 1024
+#define SHRINK_RATIO 4
+#define VEC2_SIZE (sizeof(float) * 2)
+#define OFFSET_PTR(buf) (buf->data + buf->length)
+
+vertex_buffer cgaAllocVertexBuffer(uint32_t capacity) {
+  vertex_buffer ptr = calloc(1, sizeof(vertex_buffer_t));
+
+  if (ptr == null) {
+    logError("Failed to allocate vertex buffer struct");
+    return null;
+  }
+
+  if (capacity < INITIAL_BUFFER_SIZE) {
+    capacity = INITIAL_BUFFER_SIZE;
+  }
+
+  ptr->data = malloc(capacity);
+
+  if (ptr->data == null) {
+    logError("Failed to allocate array for vertex buffer data");
+  } else {
+    ptr->capacity = capacity;
+  }
+
+  return ptr;
+}
+
+void cgaReleaseVertexBuffer(vertex_buffer buf) {
+  if (buf == null) {
+    return;
+  }
+
+  free(buf->data);
+  free(buf);
+}
+
+static boolean resize(vertex_buffer buf, uint32_t ncap) {
+  uint8_t* nptr = realloc(buf->data, ncap);
+
+  if (nptr == null) {
+    logError("Failed to resize vertex array");
+    return false;
+  }
+
+  buf->data = nptr;
+  buf->capacity = ncap;
+
+  return true;
+}
+
+static boolean ensureWritable(vertex_buffer buf, uint32_t bytesToWrite) {
+  uint32_t len = buf->length;
+
+  if (bytesToWrite > UINT32_MAX - len) {
+    logError("Vertex array exceeds 4 GiB");
+    return false;
+  }
+
+  uint32_t nlen = bytesToWrite + len;
+
+  if (nlen <= buf->capacity) {
+    return true;
+  }
+
+  // Double so building a large mesh costs amortized O(1) per push
+  uint64_t ncap = buf->capacity < INITIAL_BUFFER_SIZE ? INITIAL_BUFFER_SIZE : buf->capacity;
+
+  while (ncap < nlen) {
+    ncap *= 2;
+  }
+
+  return resize(buf, ncap > UINT32_MAX ? UINT32_MAX : (uint32_t) ncap);
+}
+
+boolean cgaReserveBuffer(vertex_buffer buf, uint32_t bytes) {
+  return ensureWritable(buf, bytes);
+}
+
+void* cgaWriteSpan(vertex_buffer buf, uint32_t bytes) {
+  if (!ensureWritable(buf, bytes)) {
+    return null;
+  }
+
+  void* span = OFFSET_PTR(buf);
+  buf->length += bytes;
+
+  return span;
+}
+
+void* cgaWriteVertices(vertex_buffer buf, const vertex_layout_t* layout, uint32_t count) {
+  uint64_t bytes = (uint64_t) layout->stride * count;
+
+  if (bytes > UINT32_MAX) {
+    logError("Vertex array exceeds 4 GiB");
+    return null;
+  }
+
+  return cgaWriteSpan(buf, (uint32_t) bytes);
+}
+
+void cgaSetBufferShrinkPolicy(vertex_buffer buf, uint32_t clears) {
+  buf->shrinkAfterClears = clears;
+  buf->clearCount = 0;
+  buf->peakLength = 0;
+}
+
+static void applyShrinkPolicy(vertex_buffer buf) {
+  if (buf->length > buf->peakLength) {
+    buf->peakLength = buf->length;
+  }
+
+  if (++buf->clearCount < buf->shrinkAfterClears) {
+    return;
+  }
+
+  uint64_t target = (uint64_t) buf->peakLength * 2;
+
+  if (target < INITIAL_BUFFER_SIZE) {
+    target = INITIAL_BUFFER_SIZE;
+  }
+
+  if ((uint64_t) buf->capacity > (uint64_t) buf->peakLength * SHRINK_RATIO && target < buf->capacity) {
+    resize(buf, (uint32_t) target);
+  }
+
+  buf->clearCount = 0;
+  buf->peakLength = 0;
+}
+
+void cgaClearBuffer(vertex_buffer buf) {
+  if (buf == null || buf->capacity < 1) {
+    return;
+  }
+
+  if (buf->shrinkAfterClears > 0) {
+    applyShrinkPolicy(buf);
+  }
+
+  buf->length = 0;
+}
+
+void cgaPushVertex2f(vertex_buffer buf, float x, float y) {
+  if (!ensureWritable(buf, VEC2_SIZE)) {
+    return;
+  }
+
+  float* fPtr = (float*) OFFSET_PTR(buf);
+  fPtr[0] = x;
+  fPtr[1] = y;
+
+  buf->length += VEC2_SIZE;
+}
+
+#define PUSH_SINGLE_VALUE(type, val, buf) \
+  if (!ensureWritable(buf, sizeof(type))) {\
+    return;\
+  }\
+  type* ptr = (type*) (buf->data + buf->length);\
+  ptr[0] = val;\
+  buf->length += sizeof(type);
+
+void cgaPushF32(vertex_buffer buf, float f) {
+  PUSH_SINGLE_VALUE(float, f, buf)
+}
+void cgaPushF64(vertex_buffer buf, double d)
+ {
+  PUSH_SINGLE_VALUE(double, d, buf)
+}
+
+void cgaPushI32(vertex_buffer buf, int32_t i) {
+  PUSH_SINGLE_VALUE(int32_t, i, buf)
+}
+
+void cgaPushU32(vertex_buffer buf, uint32_t i) {
+  PUSH_SINGLE_VALUE(uint32_t, i, buf)
+}
+
+void cgaPushU8(vertex_buffer buf, uint8_t u8) {
+  PUSH_SINGLE_VALUE(uint8_t, u8, buf)
+}
@@ -0,0 +1,94 @@
+#ifndef CGA_VERTEX_H
+#define CGA_VERTEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cga_core.h"
+
+// CPU side vertex storage, GL objects are added by cga_render.h
+
+#define VERTEX_LAYOUT_MAX_ATTRIBS 4
+
+typedef struct VertexBuffer {
+  uint32_t id;
+  uint32_t bufferId;
+  uint32_t capacity;
+  uint32_t length;
+  uint8_t* data;
+
+  // Shrink policy, see cgaSetBufferShrinkPolicy
+  uint32_t shrinkAfterClears;
+  uint32_t clearCount;
+  uint32_t peakLength;
+} vertex_buffer_t;
+
+typedef vertex_buffer_t* vertex_buffer;
+
+// Also the attribute location in core profile shaders
+typedef enum {
+  ATTRIB_POSITION,
+  ATTRIB_TEXCOORD,
+  ATTRIB_COLOR
+} vertex_attrib_usage_t;
+
+typedef enum {
+  ATTRIB_F32,
+  ATTRIB_U8
+} vertex_attrib_type_t;
+
+typedef struct VertexAttrib {
+  vertex_attrib_usage_t usage;
+  vertex_attrib_type_t type;
+  int components;
+  uint32_t offset;
+} vertex_attrib_t;
+
+// Interleaved layout of one vertex struct
+typedef struct VertexLayout {
+  uint32_t stride;
+  int attribCount;
+  vertex_attrib_t attribs[VERTEX_LAYOUT_MAX_ATTRIBS];
+} vertex_layout_t;
+
+#define VERTEX_ATTRIB(usage, type, components, vertexType, member) \
+  { usage, type, components, (uint32_t) offsetof(vertexType, member) }
+
+// Vertex buffer without any GL objects, free with cgaReleaseVertexBuffer
+vertex_buffer cgaAllocVertexBuffer(uint32_t capacity);
+
+void cgaReleaseVertexBuffer(vertex_buffer buf);
+
+// Makes room for at least `bytes` more bytes without changing the length
+boolean cgaReserveBuffer(vertex_buffer buf, uint32_t bytes);
+
+// Appends `bytes` uninitialized bytes and returns a pointer to them, or null
+// if the buffer can't grow. One bounds check for the whole span.
+void* cgaWriteSpan(vertex_buffer buf, uint32_t bytes);
+
+// Appends `count` vertices of `layout`, see cgaWriteSpan
+void* cgaWriteVertices(vertex_buffer buf, const vertex_layout_t* layout, uint32_t count);
+
+// Typed cgaWriteSpan, e.g. batch_vertex_t* v = CGA_WRITE_SPAN(buf, batch_vertex_t, 6)
+#define CGA_WRITE_SPAN(buf, type, count) \
+  ((type*) cgaWriteSpan((buf), (uint32_t) (sizeof(type) * (count))))
+
+// After every `clears` calls to cgaClearBuffer, gives memory back if the
+// capacity is more than 4 times the largest length seen since. 0, the
+// default, never shrinks.
+void cgaSetBufferShrinkPolicy(vertex_buffer buf, uint32_t clears);
+
+void cgaClearBuffer(vertex_buffer buf);
+
+void cgaPushVertex2f(vertex_buffer buf, float x, float y);
+
+void cgaPushF32(vertex_buffer buf, float f);
+
+void cgaPushF64(vertex_buffer buf, double d);
+
+void cgaPushI32(vertex_buffer buf, int32_t i);
+
+void cgaPushU32(vertex_buffer buf, uint32_t i);
+
+void cgaPushU8(vertex_buffer buf, uint8_t u8);
+
+#endif // CGA_VERTEX_H
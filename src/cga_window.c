@@ -2,17 +2,49 @@
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "log.h"
 #include "cga_window.h"
+#include "cga_batch.h"
+#include "cga_render.h"
+#include "cga_frame_stats.h"
+#include "cga_profile.h"
+#include "cga_gpu_timer.h"
+#include "cga_gl_state.h"
+#include "cga_triple_buffer.h"
 #include <GL/glew.h>
 #include "GLFW/glfw3.h"
 
+#ifdef CGA_HAS_EGL
+  #include "cga_offscreen.h"
+#endif
+
+// Wakes up now and then while idle even without events
+#define IDLE_WAIT_TIMEOUT 0.5
+#define LIMITER_MIN_SPIN 0.0002
+#define DEFAULT_FRAME_BUDGET (1.0 / 60.0)
+
 typedef GLFWwindow* window_t;
 
+typedef struct FrameLimiter {
+  double deadline;
+  // How much longer than asked cgaSleep tends to take, learned per frame
+  double overshoot;
+} frame_limiter_t;
+
+// Engine part of every snapshot, the game's part follows it
+typedef union SnapshotHeader {
+  // Earliest input this snapshot is the first to show, 0 if none
+  double inputTime;
+  max_align_t align;
+} snapshot_header_t;
+
 static key_callback_t callback = NULL;
 static window_t win;
 static frame_callback_t frameCallback;
+static frame_callback_t frameEndCallback = NULL;
+static frame_callback_t overlayCallback = NULL;
 
 static double lastStart = 0;
 static float deltaTime = 1;
@@ -21,15 +53,84 @@ static int width = 640;
 static int height = 480;
 static char* title = "A C Game attempt.";
 static boolean bVsyncState = true;
+static context_profile_t contextProfile = CONTEXT_AUTO;
+static window_mode_t windowMode = WINDOW_VISIBLE;
+static boolean offscreenActive = false;
+static boolean offscreenShouldClose = false;
+static int frameLimit = 0;
+
+static loop_mode_t loopMode = LOOP_CONTINUOUS;
+static atomic_int redrawRequested = 0;
+static int frameCap = 0;
+static frame_limiter_t frameLimiter = {.overshoot = LIMITER_MIN_SPIN};
 
 static int frameCounter = 0;
-static float frameActiveTime = 0.0f;
+static double frameActiveTime = 0;
+static frame_times_t frameTimes = {.budget = DEFAULT_FRAME_BUDGET};
+// The loop slept before this frame, its interval is idle time
+static boolean resumedFromIdle = false;
+
+static const char* phaseNames[FRAME_PHASE_COUNT] = {
+  "clear", "sim", "update", "overlay", "batch flush", "frame end", "swap", "frame cap", "poll"
+};
+
+// Only phases that submit GL work get a GPU timer
+static const boolean gpuPhases[FRAME_PHASE_COUNT] = {
+  [FRAME_PHASE_CLEAR] = true,
+  [FRAME_PHASE_UPDATE] = true,
+  [FRAME_PHASE_OVERLAY] = true,
+  [FRAME_PHASE_FLUSH] = true,
+  [FRAME_PHASE_FRAME_END] = true
+};
+
+static gpu_timer phaseTimers[FRAME_PHASE_COUNT] = {0};
+static boolean gpuPhaseTimers = false;
+// Applied at the start of the next frame, on the thread that owns GL
+static atomic_int gpuPhaseTimersRequested = 0;
+static frame_phase_times_t phaseTimes = {0};
+static frame_phase_times_t lastPhaseTimes = {0};
+static double phaseStart = 0;
+
+static thread_mode_t threadMode = THREAD_MODE_SINGLE;
+static frame_callback_t simCallback = NULL;
+static int simRate = 0;
+static frame_limiter_t simLimiter = {.overshoot = LIMITER_MIN_SPIN};
+static atomic_uint_fast64_t simTicks = 0;
+// Milliseconds the latest sim tick took, for the frame's sim phase
+static _Atomic double simTickTime = 0;
+
+static triple_buffer snapshots = null;
+static const void* frameSnapshot = null;
+// Main thread side, the earliest input not published yet and the input
+// time of the latest snapshot
+static double pendingInputTime = 0;
+static double publishedInputTime = 0;
+// Frame side, the input the current frame shows and the last one measured
+static double frameInputTime = 0;
+static double measuredInputTime = 0;
+static frame_times_t inputLatency = {.budget = DEFAULT_FRAME_BUDGET};
+
+static pthread_t renderThread;
+static pthread_mutex_t renderLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t renderWake = PTHREAD_COND_INITIALIZER;
+static atomic_int renderStop = 0;
+// The render thread reached the frame limit or lost the context
+static atomic_int renderDone = 0;
+static atomic_int renderRedraw = 0;
+static _Thread_local boolean onRenderThread = false;
+// Framebuffer size polled by the main thread for the render thread
+static atomic_int polledWidth = 0;
+static atomic_int polledHeight = 0;
 
 static void onError(int error, const char* desc) {
   printf("[ERROR] %s\n", desc);
 }
 
 static void onKeyCallback(window_t window, int key, int scancode, int action, int mods) {
+  // Input is what changes the picture, always redraw after it
+  cgaRequestRedraw();
+  cgaNoteInput();
+
   if (!callback) {
     return;
   }
@@ -37,13 +138,22 @@ static void onKeyCallback(window_t window, int key, int scancode, int action, in
   callback(key, action, mods);
 }
 
-int cgaInit() {
+static void onFramebufferSize(window_t window, int w, int h) {
+  cgaRequestRedraw();
+}
+
+// The window contents were damaged, e.g. uncovered, redraw them
+static void onRefresh(window_t window) {
+  cgaRequestRedraw();
+}
+
+static boolean createWindow(boolean* core) {
   window_t window;
   glfwSetErrorCallback(onError);
 
   if (!glfwInit()) {
     logError("Failed to initialize GLFW");
-    return 0;
+    return false;
   } else {
     int maj = 0;
     int min = 0;
@@ -52,30 +162,119 @@ int cgaInit() {
     logDebugF("GLFW initialized, version=%i.%i.%i", maj, min, rev);
   }
 
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+  window = NULL;
+
+  if (*core) {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+
+    window = glfwCreateWindow(640, 480, "C Game Attempt", NULL, NULL);
+
+    if (window == NULL && contextProfile == CONTEXT_AUTO) {
+      logWarn("GL 3.3 core context unavailable, falling back to fixed function");
+      glfwDefaultWindowHints();
+      *core = false;
+    }
+  }
+
+  if (!*core) {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
 
-  window = glfwCreateWindow(640, 480, "C Game Attempt", NULL, NULL);
+    window = glfwCreateWindow(640, 480, "C Game Attempt", NULL, NULL);
+  }
 
   if (window == NULL) {
     glfwTerminate();
     logError("Window creation failed, exiting");
-    return 0;
+    return false;
   } else {
     logDebug("Window initialized successfully");
   }
 
   glfwSetKeyCallback(window, onKeyCallback);
+  glfwSetFramebufferSizeCallback(window, onFramebufferSize);
+  glfwSetWindowRefreshCallback(window, onRefresh);
   glfwMakeContextCurrent(window);
 
+  win = window;
+  return true;
+}
+
+static boolean createOffscreen(boolean* core) {
+#ifdef CGA_HAS_EGL
+  boolean requestedCore = *core;
+
+  if (!cgaOffscreenInit(width, height, core)) {
+    return false;
+  }
+
+  if (requestedCore && !*core && contextProfile == CONTEXT_CORE) {
+    logError("GL 3.3 core context unavailable offscreen");
+    cgaOffscreenClose();
+    return false;
+  }
+
+  logDebugF("Offscreen context initialized, %ix%i", width, height);
+  offscreenActive = true;
+  return true;
+#else
+  logError("Offscreen rendering needs EGL, which this build doesn't have");
+  return false;
+#endif
+}
+
+static void destroyContext() {
+  if (windowMode == WINDOW_OFFSCREEN) {
+#ifdef CGA_HAS_EGL
+    cgaOffscreenClose();
+#endif
+    offscreenActive = false;
+    return;
+  }
+
+  glfwDestroyWindow(win);
+  glfwTerminate();
+  win = NULL;
+}
+
+static boolean shouldClose() {
+  if (windowMode == WINDOW_OFFSCREEN) {
+    return offscreenShouldClose;
+  }
+
+  return glfwWindowShouldClose(win);
+}
+
+static double getTime() {
+  return windowMode == WINDOW_OFFSCREEN ? cgaGetTime() : glfwGetTime();
+}
+
+int cgaInit() {
+  boolean core = contextProfile != CONTEXT_LEGACY;
+  boolean created = windowMode == WINDOW_OFFSCREEN ? createOffscreen(&core) : createWindow(&core);
+
+  if (!created) {
+    return 0;
+  }
+
   glewExperimental = true;
   uint32_t glewInitResult = glewInit();
 
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+  // A GLX build of GLEW loads the GL entry points first and only then fails
+  // to find a GLX display, which an EGL context never has
+  if (glewInitResult == GLEW_ERROR_NO_GLX_DISPLAY && windowMode == WINDOW_OFFSCREEN) {
+    logDebug("GLEW found no GLX display, using the EGL context anyway");
+    glewInitResult = GLEW_OK;
+  }
+#endif
+
   if (glewInitResult != GLEW_OK) {
     logErrorF("GLEW initialization failed! %s", glewGetErrorString(glewInitResult));
-
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    destroyContext();
 
     return false;
   } else {
@@ -85,64 +284,634 @@ int cgaInit() {
     glGetIntegerv(GL_MAJOR_VERSION, &glVerMajor);
     glGetIntegerv(GL_MINOR_VERSION, &glVerMinor);
 
-    logDebugF("GLEW initialized successfully, glew.version=%s gl.version=%i.%i",
-      glewGetString(GLEW_VERSION), glVerMajor, glVerMinor
+    logDebugF("GLEW initialized successfully, glew.version=%s gl.version=%i.%i core=%i",
+      glewGetString(GLEW_VERSION), glVerMajor, glVerMinor, core
     );
   }
 
-  glfwSwapInterval(bVsyncState);
-  win = window;
+  // glewInit queries extensions the old way, which core profiles reject
+  // with GL_INVALID_ENUM
+  while (glGetError() != GL_NO_ERROR) {
+  }
+
+  cgaSetCoreProfile(core);
+  cgaGlStateReset();
+
+  if (win != NULL) {
+    glfwSwapInterval(bVsyncState);
+  }
+
+  cgaBatchInit();
 
   return 1;
 }
 
-void cgaLoop() {
-  while (!glfwWindowShouldClose(win)) {
-    glfwGetFramebufferSize(win, &width, &height);
-    ratio = width / (float) height;
+// Blocks until a redraw is requested. Returns false if the wait ended
+// without one, the loop then checks whether to close and waits again.
+// idled is set if it slept.
+static boolean waitForRedraw(boolean* idled) {
+  if (atomic_load(&redrawRequested)) {
+    glfwPollEvents();
+  } else {
+    glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+    *idled = true;
+  }
+
+  return atomic_exchange(&redrawRequested, 0) != 0;
+}
+
+// Sleeps for most of the remaining frame time and spins the rest, sleeps
+// alone overshoot by up to a scheduler tick. Without spin it only sleeps,
+// for threads that would take the core from the render thread.
+static void limitRate(frame_limiter_t* limiter, int fps, boolean spin) {
+  if (fps <= 0) {
+    return;
+  }
+
+  double period = 1.0 / fps;
+  double now = getTime();
+
+  limiter->deadline += period;
 
-    glViewport(0, 0, width, height);
-    glClear(GL_COLOR_BUFFER_BIT);
+  // Too far behind, e.g. after idling, pace from now instead of rushing
+  // through frames to catch up
+  if (limiter->deadline < now - period) {
+    limiter->deadline = now;
+  }
+
+  if (!spin) {
+    if (limiter->deadline > now) {
+      cgaSleep(limiter->deadline - now);
+    }
+
+    return;
+  }
+
+  double sleepFor = limiter->deadline - now - limiter->overshoot;
+
+  if (sleepFor > 0) {
+    cgaSleep(sleepFor);
+
+    double overshoot = getTime() - now - sleepFor;
+
+    // Adopt a late wake-up at once, relax slowly after early ones
+    if (overshoot > limiter->overshoot) {
+      limiter->overshoot = overshoot;
+    } else {
+      limiter->overshoot = limiter->overshoot * 0.95 + overshoot * 0.05;
+    }
+
+    if (limiter->overshoot < LIMITER_MIN_SPIN) {
+      limiter->overshoot = LIMITER_MIN_SPIN;
+    }
+  }
+
+  while (getTime() < limiter->deadline) {
+  }
+}
+
+static void beginPhase(frame_phase_t phase) {
+  profileBegin(phaseNames[phase]);
+  phaseStart = getTime();
+
+  if (gpuPhaseTimers && phaseTimers[phase] != null) {
+    cgaGpuTimerBegin(phaseTimers[phase]);
+  }
+}
 
-    double start = glfwGetTime();
+static void endPhase(frame_phase_t phase) {
+  if (gpuPhaseTimers && phaseTimers[phase] != null) {
+    cgaGpuTimerEnd(phaseTimers[phase]);
+  }
+
+  phaseTimes.cpu[phase] = (getTime() - phaseStart) * 1e3;
+  profileEnd();
+}
 
-    deltaTime = (float) (start - lastStart);
-    lastStart = start;
+static void applyGpuPhaseTimers() {
+  gpuPhaseTimers = atomic_load(&gpuPhaseTimersRequested) != 0;
 
-    frameCounter++;
-    frameActiveTime += deltaTime;
+  if (!gpuPhaseTimers) {
+    return;
+  }
 
-    if (frameCallback != NULL) {
-      frameCallback(deltaTime, ratio);
+  for (int i = 0; i < FRAME_PHASE_COUNT; i++) {
+    if (gpuPhases[i] && phaseTimers[i] == null) {
+      phaseTimers[i] = cgaGpuTimerCreate();
     }
+  }
+}
+
+// Results arrive a few frames late, each phase shows its newest one
+static void collectGpuPhases() {
+  applyGpuPhaseTimers();
 
+  for (int i = 0; i < FRAME_PHASE_COUNT; i++) {
+    phaseTimes.cpu[i] = 0;
+    phaseTimes.gpu[i] = gpuPhaseTimers && phaseTimers[i] != null ? cgaGpuTimerLatest(phaseTimers[i]) : -1;
+  }
+}
+
+static void freePhaseTimers() {
+  for (int i = 0; i < FRAME_PHASE_COUNT; i++) {
+    cgaGpuTimerFree(phaseTimers[i]);
+    phaseTimers[i] = null;
+  }
+}
+
+static double earliestInput(double a, double b) {
+  if (a == 0 || b == 0) {
+    return a != 0 ? a : b;
+  }
+
+  return a < b ? a : b;
+}
+
+// Picks the snapshot the frame draws and the input it's the first to show
+static void takeSnapshot() {
+  if (snapshots == null) {
+    // Without snapshots the single thread loop draws the game directly
+    frameInputTime = pendingInputTime;
+    pendingInputTime = 0;
+    return;
+  }
+
+  boolean fresh = false;
+  const snapshot_header_t* header = cgaTripleBufferLatest(snapshots, &fresh);
+
+  frameSnapshot = header != null ? header + 1 : null;
+  frameInputTime = fresh ? header->inputTime : 0;
+}
+
+static void measureInputLatency() {
+  if (frameInputTime <= measuredInputTime) {
+    return;
+  }
+
+  cgaFrameTimesPush(&inputLatency, getTime() - frameInputTime);
+  measuredInputTime = frameInputTime;
+}
+
+// Draws one frame. With a render thread the sim and input run elsewhere
+// and the frame only takes the newest snapshot.
+static void runFrame(boolean threaded, boolean pollEvents) {
+  profileBegin("frame");
+  collectGpuPhases();
+  beginPhase(FRAME_PHASE_CLEAR);
+
+  if (threaded) {
+    width = atomic_load(&polledWidth);
+    height = atomic_load(&polledHeight);
+  } else if (win != NULL) {
+    glfwGetFramebufferSize(win, &width, &height);
+  }
+
+  ratio = width / (float) height;
+
+  glViewport(0, 0, width, height);
+  glClear(GL_COLOR_BUFFER_BIT);
+  endPhase(FRAME_PHASE_CLEAR);
+
+  double start = getTime();
+  double interval = start - lastStart;
+
+  deltaTime = (float) interval;
+  lastStart = start;
+
+  frameCounter++;
+  frameActiveTime += interval;
+
+  if (!resumedFromIdle) {
+    cgaFrameTimesPush(&frameTimes, interval);
+  }
+
+  resumedFromIdle = false;
+
+  if (threaded) {
+    phaseTimes.cpu[FRAME_PHASE_SIM] = atomic_load(&simTickTime);
+  } else if (simCallback != NULL) {
+    beginPhase(FRAME_PHASE_SIM);
+    simCallback(deltaTime, ratio);
+    endPhase(FRAME_PHASE_SIM);
+    atomic_fetch_add(&simTicks, 1);
+  }
+
+  takeSnapshot();
+
+  if (frameCallback != NULL) {
+    beginPhase(FRAME_PHASE_UPDATE);
+    frameCallback(deltaTime, ratio);
+    endPhase(FRAME_PHASE_UPDATE);
+  }
+
+  if (overlayCallback != NULL) {
+    beginPhase(FRAME_PHASE_OVERLAY);
+    cgaBatchBeginOverlay();
+    cgaGlStateBeginOverlay();
+    overlayCallback(deltaTime, ratio);
+    cgaBatchEndOverlay();
+    cgaGlStateEndOverlay();
+    endPhase(FRAME_PHASE_OVERLAY);
+  }
+
+  beginPhase(FRAME_PHASE_FLUSH);
+  cgaBatchEndFrame();
+  endPhase(FRAME_PHASE_FLUSH);
+
+  if (frameEndCallback != NULL) {
+    beginPhase(FRAME_PHASE_FRAME_END);
+    frameEndCallback(deltaTime, ratio);
+    endPhase(FRAME_PHASE_FRAME_END);
+  }
+
+  if (win != NULL) {
+    beginPhase(FRAME_PHASE_SWAP);
     glfwSwapBuffers(win);
+    endPhase(FRAME_PHASE_SWAP);
+  }
+
+  measureInputLatency();
+
+  // Input is polled after the wait so the next frame sees the latest
+  beginPhase(FRAME_PHASE_CAP);
+  limitRate(&frameLimiter, frameCap, true);
+  endPhase(FRAME_PHASE_CAP);
+
+  if (pollEvents) {
+    beginPhase(FRAME_PHASE_POLL);
     glfwPollEvents();
+    endPhase(FRAME_PHASE_POLL);
+  }
+
+  lastPhaseTimes = phaseTimes;
+  cgaGlStateEndFrame();
+  profileEnd();
+}
+
+static boolean makeContextCurrent(boolean current) {
+  if (windowMode == WINDOW_OFFSCREEN) {
+#ifdef CGA_HAS_EGL
+    return cgaOffscreenMakeCurrent(current);
+#else
+    return false;
+#endif
+  }
+
+  glfwMakeContextCurrent(current ? win : NULL);
+  return true;
+}
+
+static void wakeMainThread() {
+  atomic_store(&redrawRequested, 1);
+
+  if (win != NULL) {
+    glfwPostEmptyEvent();
+  }
+}
+
+static void wakeRenderThread() {
+  pthread_mutex_lock(&renderLock);
+  pthread_cond_signal(&renderWake);
+  pthread_mutex_unlock(&renderLock);
+}
+
+// Sleeps until there's a snapshot the render thread hasn't drawn, a redraw
+// request or a stop. Returns false on stop.
+static boolean waitForSnapshot() {
+  pthread_mutex_lock(&renderLock);
+
+  while (!atomic_load(&renderStop) && !atomic_load(&renderRedraw) && !cgaTripleBufferHasFresh(snapshots)) {
+    pthread_cond_wait(&renderWake, &renderLock);
+    resumedFromIdle = true;
+  }
+
+  pthread_mutex_unlock(&renderLock);
+
+  atomic_store(&renderRedraw, 0);
+  return !atomic_load(&renderStop);
+}
+
+static void* renderMain(void* arg) {
+  boolean onDemand = loopMode == LOOP_ON_DEMAND && win != NULL;
+  int loopFrames = 0;
+
+  onRenderThread = true;
+  profileThreadName("render");
+
+  if (!makeContextCurrent(true)) {
+    logError("Render thread failed to take the GL context");
+    atomic_store(&renderDone, 1);
+    wakeMainThread();
+    return null;
+  }
+
+  if (win != NULL) {
+    glfwSwapInterval(bVsyncState);
+  }
+
+  lastStart = getTime();
+  frameLimiter.deadline = lastStart;
+  resumedFromIdle = true;
+
+  while (!atomic_load(&renderStop)) {
+    if (onDemand && !waitForSnapshot()) {
+      break;
+    }
+
+    runFrame(true, false);
+
+    if (frameLimit > 0 && ++loopFrames >= frameLimit) {
+      atomic_store(&renderDone, 1);
+      // The main thread may be waiting for input
+      wakeMainThread();
+      break;
+    }
+  }
+
+  makeContextCurrent(false);
+  return null;
+}
+
+// Offscreen the size only changes through cgaSetScreenSize before the loop
+static void pollFramebufferSize(float* simRatio) {
+  if (win != NULL) {
+    int w = 0;
+    int h = 0;
+    glfwGetFramebufferSize(win, &w, &h);
+
+    atomic_store(&polledWidth, w);
+    atomic_store(&polledHeight, h);
+  }
+
+  *simRatio = atomic_load(&polledWidth) / (float) atomic_load(&polledHeight);
+}
+
+static void runSingleThreaded() {
+  int loopFrames = 0;
+  boolean onDemand = loopMode == LOOP_ON_DEMAND && win != NULL;
+
+  lastStart = getTime();
+  frameLimiter.deadline = lastStart;
+  atomic_store(&redrawRequested, 1);
+  // Nothing to measure the first frame against
+  resumedFromIdle = true;
+
+  while (!shouldClose()) {
+    if (onDemand) {
+      profileBegin("wait");
+      boolean redraw = waitForRedraw(&resumedFromIdle);
+      profileEnd();
+
+      if (!redraw) {
+        continue;
+      }
+    }
+
+    runFrame(false, win != NULL && !onDemand);
+
+    if (frameLimit > 0 && ++loopFrames >= frameLimit) {
+      break;
+    }
+  }
+}
+
+// The main thread keeps input and the sim, the render thread owns GL
+static void runRenderThread() {
+  boolean onDemand = loopMode == LOOP_ON_DEMAND && win != NULL;
+  boolean idled = false;
+  float simRatio = ratio;
+
+  atomic_store(&renderStop, 0);
+  atomic_store(&renderDone, 0);
+  atomic_store(&redrawRequested, 1);
+  atomic_store(&polledWidth, width);
+  atomic_store(&polledHeight, height);
+  pollFramebufferSize(&simRatio);
+
+  if (!makeContextCurrent(false) || pthread_create(&renderThread, null, renderMain, null) != 0) {
+    logError("Failed to start the render thread, drawing on the main thread");
+    makeContextCurrent(true);
+    runSingleThreaded();
+    return;
+  }
+
+  double lastTick = getTime();
+  simLimiter.deadline = lastTick;
+
+  while (!shouldClose() && !atomic_load(&renderDone)) {
+    if (onDemand) {
+      profileBegin("wait");
+      boolean redraw = waitForRedraw(&idled);
+      profileEnd();
+
+      if (!redraw) {
+        continue;
+      }
+    } else if (win != NULL) {
+      glfwPollEvents();
+    }
+
+    pollFramebufferSize(&simRatio);
+
+    double start = getTime();
+    float simDelta = (float) (start - lastTick);
+    lastTick = start;
+
+    if (simCallback != NULL) {
+      profileBegin(phaseNames[FRAME_PHASE_SIM]);
+      simCallback(simDelta, simRatio);
+      profileEnd();
+    }
+
+    atomic_store(&simTickTime, (getTime() - start) * 1e3);
+    atomic_fetch_add(&simTicks, 1);
+
+    if (!onDemand) {
+      limitRate(&simLimiter, simRate, false);
+    }
+  }
+
+  atomic_store(&renderStop, 1);
+  wakeRenderThread();
+  pthread_join(renderThread, null);
+
+  // Teardown frees GL objects on this thread
+  makeContextCurrent(true);
+}
+
+void cgaLoop() {
+  profileThreadName("main");
+
+  if (threadMode == THREAD_MODE_RENDER_THREAD && snapshots == null) {
+    logWarn("The render thread draws snapshots, call cgaSetSnapshotSize first. Drawing on the main thread.");
+    runSingleThreaded();
+    return;
+  }
+
+  if (threadMode == THREAD_MODE_RENDER_THREAD) {
+    runRenderThread();
+  } else {
+    runSingleThreaded();
   }
 }
 
 void cgaClose() {
-  glfwDestroyWindow(win);
-  glfwTerminate();
+  freePhaseTimers();
+  cgaFreeTripleBuffer(snapshots);
+  snapshots = null;
+  frameSnapshot = null;
+  cgaBatchClose();
+  destroyContext();
   logInfo("Window closed");
 }
 
+void cgaSetWindowMode(window_mode_t mode) {
+  windowMode = mode;
+}
+
+void cgaSetLoopMode(loop_mode_t mode) {
+  loopMode = mode;
+}
+
+void cgaRequestRedraw() {
+  // The render thread checks this before it waits again
+  if (onRenderThread) {
+    atomic_store(&renderRedraw, 1);
+    return;
+  }
+
+  // Only the first request needs to wake the loop
+  if (atomic_exchange(&redrawRequested, 1) == 0 && win != NULL) {
+    glfwPostEmptyEvent();
+  }
+}
+
+void cgaSetOverlayCallback(frame_callback_t callbackfn) {
+  overlayCallback = callbackfn;
+}
+
+void cgaSetGpuPhaseTimers(boolean enabled) {
+  atomic_store(&gpuPhaseTimersRequested, enabled);
+}
+
+const char* cgaGetFramePhaseName(frame_phase_t phase) {
+  return phase >= 0 && phase < FRAME_PHASE_COUNT ? phaseNames[phase] : "?";
+}
+
+void cgaGetFramePhaseTimes(frame_phase_times_t* times) {
+  *times = lastPhaseTimes;
+}
+
+void cgaSetFrameCap(int fps) {
+  frameCap = fps > 0 ? fps : 0;
+}
+
+void cgaSetFrameLimit(int frames) {
+  frameLimit = frames;
+}
+
+void cgaSetFrameEndCallback(frame_callback_t callbackfn) {
+  frameEndCallback = callbackfn;
+}
+
+void cgaSetContextProfile(context_profile_t profile) {
+  contextProfile = profile;
+}
+
 void cgaSetKeyCallback(key_callback_t callbackfn) {
   callback = callbackfn;
 }
 
 void cgaSetShouldClose(int bState) {
   if (win == NULL) {
+    offscreenShouldClose = bState;
     return;
   }
 
   glfwSetWindowShouldClose(win, bState);
+  cgaRequestRedraw();
 }
 
 void cgaSetFrameCallback(frame_callback_t callbackfn) {
   frameCallback = callbackfn;
 }
 
+void cgaSetSimCallback(frame_callback_t callbackfn) {
+  simCallback = callbackfn;
+}
+
+void cgaSetThreadMode(thread_mode_t mode) {
+  threadMode = mode;
+}
+
+thread_mode_t cgaGetThreadMode() {
+  return threadMode;
+}
+
+void cgaSetSimRate(int hz) {
+  simRate = hz > 0 ? hz : 0;
+}
+
+boolean cgaSetSnapshotSize(size_t size) {
+  cgaFreeTripleBuffer(snapshots);
+  frameSnapshot = null;
+  snapshots = cgaGenTripleBuffer(sizeof(snapshot_header_t) + size);
+
+  return snapshots != null;
+}
+
+void* cgaSnapshotBegin() {
+  if (snapshots == null) {
+    return null;
+  }
+
+  snapshot_header_t* header = cgaTripleBufferBack(snapshots);
+  return header + 1;
+}
+
+void cgaSnapshotPublish() {
+  if (snapshots == null) {
+    return;
+  }
+
+  snapshot_header_t* header = cgaTripleBufferBack(snapshots);
+
+  // While the previous snapshot waits unseen, its inputs are first shown
+  // by this one. If it's taken right now they're measured with it and
+  // skipped here, measureInputLatency only counts newer inputs.
+  double unseen = cgaTripleBufferHasFresh(snapshots) ? publishedInputTime : 0;
+
+  header->inputTime = earliestInput(unseen, pendingInputTime);
+  publishedInputTime = header->inputTime;
+  pendingInputTime = 0;
+
+  cgaTripleBufferPublish(snapshots);
+
+  if (threadMode == THREAD_MODE_RENDER_THREAD) {
+    wakeRenderThread();
+  }
+}
+
+const void* cgaGetSnapshot() {
+  return frameSnapshot;
+}
+
+void cgaNoteInput() {
+  if (pendingInputTime == 0) {
+    pendingInputTime = getTime();
+  }
+}
+
+void cgaGetInputLatencyStats(frame_time_stats_t* stats) {
+  cgaFrameTimesCompute(&inputLatency, stats);
+}
+
+void cgaGetSimStats(sim_stats_t* stats) {
+  stats->ticks = atomic_load(&simTicks);
+  stats->snapshots = snapshots != null ? atomic_load(&snapshots->published) : 0;
+  stats->skipped = snapshots != null ? atomic_load(&snapshots->skipped) : 0;
+}
+
 void cgaSetScreenSize(int w, int h) {
   width = w;
   height = h;
@@ -151,6 +920,12 @@ void cgaSetScreenSize(int w, int h) {
   if (win != NULL) {
     glfwSetWindowSize(win, width, height);
   }
+
+#ifdef CGA_HAS_EGL
+  if (offscreenActive) {
+    cgaOffscreenResize(width, height);
+  }
+#endif
 }
 
 void cgaGetScreenSize(int* w, int* h) {
@@ -164,6 +939,11 @@ void cgaGetScreenSize(int* w, int* h) {
   glfwGetWindowSize(win, w, h);
 }
 
+void cgaGetFramebufferSize(int* w, int* h) {
+  *w = width;
+  *h = height;
+}
+
 void cgaSetScreenTitle(const char* t) {
   if (!t) {
     return;
@@ -182,11 +962,26 @@ float cgaGetScreenRatio() {
 
 
 float cgaGetFps() {
-  return frameCounter / frameActiveTime;
+  frame_time_stats_t stats;
+  cgaFrameTimesCompute(&frameTimes, &stats);
+
+  return stats.mean > 0 ? (float) (1.0 / stats.mean) : 0;
 }
 
 float cgaGetActiveTime() {
-  return frameActiveTime;
+  return (float) frameActiveTime;
+}
+
+void cgaSetFrameBudget(double seconds) {
+  frameTimes.budget = seconds;
+}
+
+void cgaGetFrameTimeStats(frame_time_stats_t* stats) {
+  cgaFrameTimesCompute(&frameTimes, stats);
+}
+
+const frame_times_t* cgaGetFrameTimes() {
+  return &frameTimes;
 }
 
 float cgaGetDeltaTime() {
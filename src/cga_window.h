@@ -1,11 +1,79 @@
 #ifndef CGA_WINDOW_H
 #define CGA_WINDOW_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "cga_core.h"
+#include "cga_frame_stats.h"
+
+typedef enum {
+  // 3.3 core profile if the driver has one, 2.0 otherwise
+  CONTEXT_AUTO,
+  CONTEXT_CORE,
+  CONTEXT_LEGACY
+} context_profile_t;
+
+typedef enum {
+  WINDOW_VISIBLE,
+  // No window or input, frames go to an EGL pbuffer of the screen size.
+  // Runs without a display, e.g. on Mesa's llvmpipe.
+  WINDOW_OFFSCREEN
+} window_mode_t;
+
+typedef enum {
+  // Draws frames back to back, at most at the frame cap
+  LOOP_CONTINUOUS,
+  // Sleeps in glfwWaitEventsTimeout until input, a resize or
+  // cgaRequestRedraw. Offscreen contexts always run continuously.
+  LOOP_ON_DEMAND
+} loop_mode_t;
+
+typedef enum {
+  // Input, simulation and drawing take turns on the calling thread
+  THREAD_MODE_SINGLE,
+  // The calling thread handles input and runs the sim callback, a render
+  // thread owns the GL context and draws the latest snapshot
+  THREAD_MODE_RENDER_THREAD
+} thread_mode_t;
+
+// Steps of a cgaLoop frame, in order. With a render thread the sim phase
+// runs on the main thread and shows its latest tick.
+typedef enum {
+  FRAME_PHASE_CLEAR,
+  FRAME_PHASE_SIM,
+  FRAME_PHASE_UPDATE,
+  FRAME_PHASE_OVERLAY,
+  FRAME_PHASE_FLUSH,
+  FRAME_PHASE_FRAME_END,
+  FRAME_PHASE_SWAP,
+  FRAME_PHASE_CAP,
+  FRAME_PHASE_POLL,
+  FRAME_PHASE_COUNT
+} frame_phase_t;
+
+typedef struct FramePhaseTimes {
+  // Milliseconds, 0 for phases the frame skipped
+  double cpu[FRAME_PHASE_COUNT];
+  // Milliseconds from a few frames back, negative if not measured
+  double gpu[FRAME_PHASE_COUNT];
+} frame_phase_times_t;
+
+typedef struct SimStats {
+  uint64_t ticks;
+  uint64_t snapshots;
+  // Snapshots replaced by a newer one before a frame drew them
+  uint64_t skipped;
+} sim_stats_t;
 
 typedef void (*key_callback_t)(int key, int action, int mods);
 typedef void (*frame_callback_t)(float deltaTime, float ratio);
 
+// Call before cgaInit
+void cgaSetContextProfile(context_profile_t profile);
+
+// Call before cgaInit
+void cgaSetWindowMode(window_mode_t mode);
+
 int cgaInit();
 
 void cgaLoop();
@@ -18,14 +86,93 @@ void cgaSetShouldClose(int bState);
 
 void cgaSetFrameCallback(frame_callback_t callbackfn);
 
+// Called on the main thread to advance the game, before each frame in
+// THREAD_MODE_SINGLE. With a render thread it runs after input or at the
+// sim rate instead, and only sees the game through published snapshots.
+void cgaSetSimCallback(frame_callback_t callbackfn);
+
+// Call before cgaLoop
+void cgaSetThreadMode(thread_mode_t mode);
+
+thread_mode_t cgaGetThreadMode();
+
+// Sim ticks per second with a render thread in LOOP_CONTINUOUS, 0 ticks
+// as fast as it can. In LOOP_ON_DEMAND the sim ticks after input.
+void cgaSetSimRate(int hz);
+
+// Game state snapshots
+//
+// The sim callback writes everything drawing needs into a snapshot and
+// publishes it, frame callbacks draw cgaGetSnapshot. A lock-free triple
+// buffer (cga_triple_buffer.h) sits in between, so neither side waits for
+// the other and frames always draw the newest snapshot. Both thread modes
+// use them, game code is the same either way.
+
+// Allocates snapshots of `size` bytes, call before cgaLoop
+boolean cgaSetSnapshotSize(size_t size);
+
+// Slot to write the next snapshot into, from the sim callback
+void* cgaSnapshotBegin();
+
+// Hands the written snapshot to the frames, never waits
+void cgaSnapshotPublish();
+
+// Newest published snapshot for the frame callbacks, null before the first
+const void* cgaGetSnapshot();
+
+// Marks an input for the latency stats, the time until the frame showing
+// it is swapped. Key events are marked automatically. Call from the sim.
+void cgaNoteInput();
+
+// Input to swap latencies of recent inputs, in seconds
+void cgaGetInputLatencyStats(frame_time_stats_t* stats);
+
+void cgaGetSimStats(sim_stats_t* stats);
+
+// Called once the frame's draws are submitted, before the buffers swap
+void cgaSetFrameEndCallback(frame_callback_t callbackfn);
+
+// Called after the frame callback for HUDs. Its quads are counted apart,
+// see cgaBatchBeginOverlay.
+void cgaSetOverlayCallback(frame_callback_t callbackfn);
+
+// Times the GL work of each phase with GL_TIME_ELAPSED queries, off by
+// default. GL allows one such query at a time, so other GPU timers can't
+// span a phase while this is on. Takes effect with the next frame, callable
+// from any thread.
+void cgaSetGpuPhaseTimers(boolean enabled);
+
+const char* cgaGetFramePhaseName(frame_phase_t phase);
+
+// Times of the last finished frame
+void cgaGetFramePhaseTimes(frame_phase_times_t* times);
+
+void cgaSetLoopMode(loop_mode_t mode);
+
+// Draws one more frame in LOOP_ON_DEMAND, callable from any thread. From
+// the main thread with a render thread it runs another sim tick.
+void cgaRequestRedraw();
+
+// Frames per second cgaLoop is limited to, 0 for no limit. Sleeps for most
+// of the frame and spins for the last fraction of a millisecond.
+void cgaSetFrameCap(int fps);
+
+// cgaLoop returns after this many frames, 0 runs until closed
+void cgaSetFrameLimit(int frames);
+
 void cgaSetScreenSize(int width, int height);
 
 void cgaGetScreenSize(int* width, int* height);
 
+// Size in pixels of the frame being drawn, differs from the window size on
+// high DPI screens
+void cgaGetFramebufferSize(int* width, int* height);
+
 void cgaSetScreenTitle(const char* title);
 
 float cgaGetScreenRatio();
 
+// Frames per second over the last FRAME_TIMES_CAPACITY frames
 float cgaGetFps();
 
 float cgaGetActiveTime();
@@ -34,6 +181,15 @@ float cgaGetDeltaTime();
 
 int cgaGetFrameCounter();
 
+// Frames slower than this count as hitches, 1/60 s by default
+void cgaSetFrameBudget(double seconds);
+
+// Stats over recent frame intervals. Frames drawn after an idle wait in
+// LOOP_ON_DEMAND aren't recorded, the idle time isn't a frame time.
+void cgaGetFrameTimeStats(frame_time_stats_t* stats);
+
+const frame_times_t* cgaGetFrameTimes();
+
 void cgaSetVsync(boolean bState);
 
 #endif // CGA_WINDOW_H
\ No newline at end of file
@@ -2,166 +2,85 @@
 #include <GL/glew.h>
 #include "cga_core.h"
 #include "glutil.h"
+#include "cga_batch.h"
+#include "cga_render.h"
+#include "cga_gl_state.h"
 #include "log.h"
+#include "cga_profile.h"
+#include <stdlib.h>
+#include <string.h>
 
-#define CHAR_SIZE 8
-#define CHARS 128
 #define ENDCHAR '\0'
 
-static char font8x8_basic[CHARS][CHAR_SIZE] = {
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0000 (nul)
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0001
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0002
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0003
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0004
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0005
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0006
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0007
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0008
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0009
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+000A
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+000B
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+000C
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+000D
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+000E
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+000F
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0010
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0011
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0012
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0013
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0014
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0015
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0016
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0017
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0018
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0019
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+001A
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+001B
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+001C
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+001D
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+001E
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+001F
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0020 (space)
-    { 0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00},   // U+0021 (!)
-    { 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0022 (")
-    { 0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00},   // U+0023 (#)
-    { 0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00},   // U+0024 ($)
-    { 0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00},   // U+0025 (%)
-    { 0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00},   // U+0026 (&)
-    { 0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0027 (')
-    { 0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00},   // U+0028 (()
-    { 0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00},   // U+0029 ())
-    { 0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00},   // U+002A (*)
-    { 0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00},   // U+002B (+)
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06},   // U+002C (,)
-    { 0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00},   // U+002D (-)
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00},   // U+002E (.)
-    { 0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00},   // U+002F (/)
-    { 0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00},   // U+0030 (0)
-    { 0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00},   // U+0031 (1)
-    { 0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00},   // U+0032 (2)
-    { 0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00},   // U+0033 (3)
-    { 0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00},   // U+0034 (4)
-    { 0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00},   // U+0035 (5)
-    { 0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00},   // U+0036 (6)
-    { 0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00},   // U+0037 (7)
-    { 0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00},   // U+0038 (8)
-    { 0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00},   // U+0039 (9)
-    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00},   // U+003A (:)
-    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06},   // U+003B (;)
-    { 0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00},   // U+003C (<)
-    { 0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00},   // U+003D (=)
-    { 0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00},   // U+003E (>)
-    { 0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00},   // U+003F (?)
-    { 0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00},   // U+0040 (@)
-    { 0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00},   // U+0041 (A)
-    { 0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00},   // U+0042 (B)
-    { 0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00},   // U+0043 (C)
-    { 0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00},   // U+0044 (D)
-    { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00},   // U+0045 (E)
-    { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00},   // U+0046 (F)
-    { 0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00},   // U+0047 (G)
-    { 0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00},   // U+0048 (H)
-    { 0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},   // U+0049 (I)
-    { 0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00},   // U+004A (J)
-    { 0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00},   // U+004B (K)
-    { 0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00},   // U+004C (L)
-    { 0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00},   // U+004D (M)
-    { 0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00},   // U+004E (N)
-    { 0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00},   // U+004F (O)
-    { 0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00},   // U+0050 (P)
-    { 0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00},   // U+0051 (Q)
-    { 0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00},   // U+0052 (R)
-    { 0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00},   // U+0053 (S)
-    { 0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},   // U+0054 (T)
-    { 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00},   // U+0055 (U)
-    { 0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00},   // U+0056 (V)
-    { 0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00},   // U+0057 (W)
-    { 0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00},   // U+0058 (X)
-    { 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00},   // U+0059 (Y)
-    { 0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00},   // U+005A (Z)
-    { 0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00},   // U+005B ([)
-    { 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00},   // U+005C (\)
-    { 0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00},   // U+005D (])
-    { 0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00},   // U+005E (^)
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},   // U+005F (_)
-    { 0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+0060 (`)
-    { 0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00},   // U+0061 (a)
-    { 0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00},   // U+0062 (b)
-    { 0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00},   // U+0063 (c)
-    { 0x38, 0x30, 0x30, 0x3e, 0x33, 0x33, 0x6E, 0x00},   // U+0064 (d)
-    { 0x00, 0x00, 0x1E, 0x33, 0x3f, 0x03, 0x1E, 0x00},   // U+0065 (e)
-    { 0x1C, 0x36, 0x06, 0x0f, 0x06, 0x06, 0x0F, 0x00},   // U+0066 (f)
-    { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F},   // U+0067 (g)
-    { 0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00},   // U+0068 (h)
-    { 0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},   // U+0069 (i)
-    { 0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E},   // U+006A (j)
-    { 0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00},   // U+006B (k)
-    { 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},   // U+006C (l)
-    { 0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00},   // U+006D (m)
-    { 0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00},   // U+006E (n)
-    { 0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00},   // U+006F (o)
-    { 0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F},   // U+0070 (p)
-    { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78},   // U+0071 (q)
-    { 0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00},   // U+0072 (r)
-    { 0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00},   // U+0073 (s)
-    { 0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00},   // U+0074 (t)
-    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00},   // U+0075 (u)
-    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00},   // U+0076 (v)
-    { 0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00},   // U+0077 (w)
-    { 0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00},   // U+0078 (x)
-    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F},   // U+0079 (y)
-    { 0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00},   // U+007A (z)
-    { 0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00},   // U+007B ({)
-    { 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00},   // U+007C (|)
-    { 0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00},   // U+007D (})
-    { 0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // U+007E (~)
-    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}    // U+007F
-};
+#define ATLAS_COLUMNS 16
+#define ATLAS_ROWS 8
+#define ATLAS_WIDTH (ATLAS_COLUMNS * CHAR_SIZE)
+#define ATLAS_HEIGHT (ATLAS_ROWS * CHAR_SIZE)
+
+#define TEXT_CACHE_SIZE 128
+#define TEXT_CACHE_PROBES 4
+#define TEXT_CACHE_MAX_LEN 128
+
+// U+007F has no glyph, its atlas cell is filled solid and used for plain quads
+#define SOLID_GLYPH 0x7F
+
+typedef struct {
+  boolean used;
+  uint32_t hash;
+  uint32_t lastUsed;
+  float xScale;
+  float yScale;
+  char content[TEXT_CACHE_MAX_LEN];
+  int vertexCapacity;
+  text_layout_t layout;
+} text_cache_entry_t;
 
 static boolean initialized = 0;
 static char_callback_t callback = null;
 static float textXScale = 1;
 static float textYScale = 1;
-static int fontTextureId = 0;
+static GLuint fontTextureId = 0;
+static text_draw_mode_t drawMode = TEXT_MODE_ATLAS;
+
+static text_cache_entry_t textCache[TEXT_CACHE_SIZE] = {0};
+// Layout for strings too long to cache, rebuilt on every call
+static text_cache_entry_t scratchEntry = {0};
+static uint32_t cacheClock = 0;
 
 int cgaTextDrawIsInitialized() {
   return initialized;
 }
 
+static void rasterizeGlyph(uint8_t* atlas, int glyph) {
+  const char* bitmap = font8x8_basic[glyph];
+
+  int cellX = (glyph % ATLAS_COLUMNS) * CHAR_SIZE;
+  int cellY = (glyph / ATLAS_COLUMNS) * CHAR_SIZE;
+
+  for (int y = 0; y < CHAR_SIZE; y++) {
+    for (int x = 0; x < CHAR_SIZE; x++) {
+      boolean set = glyph == SOLID_GLYPH || (bitmap[y] & (1 << x));
+      atlas[(cellY + y) * ATLAS_WIDTH + cellX + x] = set ? 255 : 0;
+    }
+  }
+}
+
+static void glyphUv(int glyph, float* u0, float* v0, float* u1, float* v1) {
+  *u0 = (glyph % ATLAS_COLUMNS) / (float) ATLAS_COLUMNS;
+  *v0 = (glyph / ATLAS_COLUMNS) / (float) ATLAS_ROWS;
+  *u1 = *u0 + 1.0f / ATLAS_COLUMNS;
+  *v1 = *v0 + 1.0f / ATLAS_ROWS;
+}
+
 boolean cgaInitTextDraw() {
   if (initialized) {
     return false;
   }
 
-  const int imgXSize = 16 * CHAR_SIZE;
-  const int imgYSize =  8 * CHAR_SIZE;
-  const int imgSize = imgXSize * imgYSize;
-
-  uint8_t* textureData[imgSize] = {0};
+  static uint8_t textureData[ATLAS_WIDTH * ATLAS_HEIGHT] = {0};
 
   for (int i = 0; i < CHARS; i++) {
-    char* data = font8x8_basic[i];
+    rasterizeGlyph(textureData, i);
   }
 
   glGenTextures(1, &fontTextureId);
@@ -171,17 +90,33 @@ boolean cgaInitTextDraw() {
     return false;
   }
 
-  glBindTexture(GL_TEXTURE_2D, fontTextureId);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, imgXSize, imgYSize, 0, GL_RED, GL_UNSIGNED_BYTE, textureData);
+  // Alpha only, so the fixed-function GL_MODULATE keeps the vertex colour.
+  // Core profiles have no alpha textures, the batch shader reads red there.
+  cgaGlBindTexture(fontTextureId);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  if (cgaIsCoreProfile()) {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, textureData);
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA8, ATLAS_WIDTH, ATLAS_HEIGHT, 0, GL_ALPHA, GL_UNSIGNED_BYTE, textureData);
+  }
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
   GLenum err = glGetError();
 
   if (err != GL_NO_ERROR) {
-    char* err = glewGetErrorString(err);
-    logErrorF("GL Error creating texture: %s", err);
+    logErrorF("GL Error creating texture: 0x%x", err);
     return false;
   }
 
+  float u0, v0, u1, v1;
+  glyphUv(SOLID_GLYPH, &u0, &v0, &u1, &v1);
+  cgaBatchSetSolidTexture(fontTextureId, (u0 + u1) / 2.0f, (v0 + v1) / 2.0f);
+
   initialized = true;
   return true;
 }
@@ -192,12 +127,26 @@ void cgaCloseTextDraw() {
   }
 
   initialized = false;
+  cgaBatchSetSolidTexture(0, 0, 0);
+
+  for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+    free(textCache[i].layout.vertices);
+  }
+
+  free(scratchEntry.layout.vertices);
+  memset(textCache, 0, sizeof(textCache));
+  memset(&scratchEntry, 0, sizeof(scratchEntry));
 
   if (fontTextureId != 0) {
-    glDeleteTextures(0, &fontTextureId);
+    cgaGlDeleteTexture(fontTextureId);
+    fontTextureId = 0;
   }
 }
 
+void cgaSetTextDrawMode(text_draw_mode_t mode) {
+  drawMode = mode;
+}
+
 void cgaSetTextScale(float xScale, float yScale) {
   textXScale = xScale;
   textYScale = yScale;
@@ -215,7 +164,7 @@ static int triggerCallback(char ch, int chIndex, float* x, float* y) {
   return callback(ch, chIndex, x, y);
 }
 
-static void drawCharAt(char bitmap[], float chx, float chy, float xscale, float yscale) {
+static void drawCharPixels(const char bitmap[], float chx, float chy, float xscale, float yscale) {
   int set = 0;
 
   float startX = 0;
@@ -241,6 +190,27 @@ static void drawCharAt(char bitmap[], float chx, float chy, float xscale, float
   }
 }
 
+// The software rasteriser only fills solid quads
+static boolean drawsPixels() {
+  return drawMode == TEXT_MODE_PIXELS || cgaBatchGetSoftTarget() != null;
+}
+
+static void drawCharAt(int glyph, float chx, float chy, float xscale, float yscale) {
+  if (drawsPixels()) {
+    drawCharPixels(font8x8_basic[glyph], chx, chy, xscale, yscale);
+    return;
+  }
+
+  float u0, v0, u1, v1;
+  glyphUv(glyph, &u0, &v0, &u1, &v1);
+
+  cgaBatchTexturedQuad(
+    fontTextureId,
+    chx, chy, chx + CHAR_SIZE * xscale, chy - CHAR_SIZE * yscale,
+    u0, v0, u1, v1
+  );
+}
+
 void cgaDrawText(float x, float y, int maxbufSize, const char* content) {
   if (!initialized) {
     return;
@@ -256,6 +226,7 @@ void cgaDrawText(float x, float y, int maxbufSize, const char* content) {
   const float sizey = CH_BASE_Y_SCALE * textYScale;
 
   int index = 0;
+  profileBegin("cgaDrawText");
 
   while (index < maxbufSize) {
     char ch = content[index++];
@@ -270,9 +241,9 @@ void cgaDrawText(float x, float y, int maxbufSize, const char* content) {
       continue;
     }
 
-    char* chData = font8x8_basic[ch];
+    int glyph = (unsigned char) ch;
 
-    if (chData == null) {
+    if (glyph >= CHARS) {
       charX += CHAR_DIF_X * sizex;
       continue;
     }
@@ -283,9 +254,11 @@ void cgaDrawText(float x, float y, int maxbufSize, const char* content) {
       continue;
     }
 
-    drawCharAt(chData, charX, charY, sizex, sizey);
+    drawCharAt(glyph, charX, charY, sizex, sizey);
     charX += CHAR_DIF_X * sizex;
   }
+
+  profileEnd();
 }
 
 #define max(a, b) (a < b ? b : a)
@@ -340,3 +313,170 @@ void cgaMeasureText(int maxBufSize, const char *content, float *width, float *he
     *lines = lineCount;
   }
 }
+
+static int textLength(int maxBufSize, const char* content) {
+  int length = 0;
+
+  while (length < maxBufSize && content[length] != ENDCHAR) {
+    length++;
+  }
+
+  return length;
+}
+
+static uint32_t hashText(const char* content, int length, float xScale, float yScale) {
+  uint32_t hash = 2166136261u;
+
+  for (int i = 0; i < length; i++) {
+    hash = (hash ^ (uint8_t) content[i]) * 16777619u;
+  }
+
+  uint32_t bits[2];
+  memcpy(&bits[0], &xScale, sizeof(float));
+  memcpy(&bits[1], &yScale, sizeof(float));
+
+  for (int i = 0; i < 2; i++) {
+    hash = (hash ^ bits[i]) * 16777619u;
+  }
+
+  return hash;
+}
+
+static boolean entryMatches(text_cache_entry_t* entry, uint32_t hash, const char* content, int length) {
+  return entry->used
+    && entry->hash == hash
+    && entry->layout.length == length
+    && entry->xScale == textXScale
+    && entry->yScale == textYScale
+    && memcmp(entry->content, content, length) == 0;
+}
+
+static boolean reserveQuads(text_cache_entry_t* entry, int quads) {
+  int needed = quads * BATCH_VERTICES_PER_QUAD;
+
+  if (needed <= entry->vertexCapacity) {
+    return true;
+  }
+
+  batch_vertex_t* nptr = realloc(entry->layout.vertices, sizeof(batch_vertex_t) * needed);
+
+  if (nptr == null) {
+    return false;
+  }
+
+  entry->layout.vertices = nptr;
+  entry->vertexCapacity = needed;
+  return true;
+}
+
+// Single pass over the string producing both the extents and the quads,
+// same rules as cgaMeasureText and cgaDrawText
+static void buildLayout(text_cache_entry_t* entry, const char* content, int length) {
+  text_layout_t* layout = &entry->layout;
+
+  const float sizex = CH_BASE_X_SCALE * textXScale;
+  const float sizey = CH_BASE_Y_SCALE * textYScale;
+
+  float charX = 0;
+  float charY = 0;
+  float maxWidth = 0;
+  int lineCount = 0;
+  int quads = 0;
+
+  if (!reserveQuads(entry, length)) {
+    length = 0;
+  }
+
+  for (int i = 0; i < length; i++) {
+    char ch = content[i];
+
+    if (ch == '\n' || ch == '\r') {
+      maxWidth = max(charX, maxWidth);
+      charX = 0;
+      charY -= CHAR_DIF_Y * sizey;
+      lineCount++;
+      continue;
+    }
+
+    int glyph = (unsigned char) ch;
+
+    if (glyph < CHARS) {
+      float u0, v0, u1, v1;
+      glyphUv(glyph, &u0, &v0, &u1, &v1);
+
+      cgaBatchBuildQuad(
+        &layout->vertices[quads * BATCH_VERTICES_PER_QUAD],
+        charX, charY, charX + CHAR_SIZE * sizex, charY - CHAR_SIZE * sizey,
+        u0, v0, u1, v1
+      );
+
+      quads++;
+    }
+
+    charX += CHAR_DIF_X * sizex;
+  }
+
+  layout->width = max(maxWidth, charX);
+  layout->height = (lineCount + 1) * CHAR_DIF_Y * sizey;
+  layout->lines = lineCount + 1;
+  layout->quadCount = quads;
+  layout->content = entry->content;
+  layout->length = length;
+
+  entry->xScale = textXScale;
+  entry->yScale = textYScale;
+}
+
+const text_layout_t* cgaLayoutText(int maxBufSize, const char* content) {
+  int length = textLength(maxBufSize, content);
+  uint32_t hash = hashText(content, length, textXScale, textYScale);
+
+  cacheClock++;
+
+  if (length >= TEXT_CACHE_MAX_LEN) {
+    // Too long to keep a copy of, the layout just points at the caller's string
+    buildLayout(&scratchEntry, content, length);
+    scratchEntry.layout.content = content;
+    return &scratchEntry.layout;
+  }
+
+  text_cache_entry_t* victim = null;
+
+  for (int i = 0; i < TEXT_CACHE_PROBES; i++) {
+    text_cache_entry_t* entry = &textCache[(hash + i) % TEXT_CACHE_SIZE];
+
+    if (entryMatches(entry, hash, content, length)) {
+      entry->lastUsed = cacheClock;
+      return &entry->layout;
+    }
+
+    if (victim == null || !entry->used || (victim->used && entry->lastUsed < victim->lastUsed)) {
+      victim = entry;
+    }
+  }
+
+  memcpy(victim->content, content, length);
+  victim->content[length] = ENDCHAR;
+  victim->hash = hash;
+  victim->used = true;
+  victim->lastUsed = cacheClock;
+
+  buildLayout(victim, victim->content, length);
+  return &victim->layout;
+}
+
+void cgaDrawLayout(const text_layout_t* layout, float x, float y) {
+  if (!initialized || layout == null) {
+    return;
+  }
+
+  // Per character callbacks and the pixel path need the original string
+  if (callback != null || drawsPixels()) {
+    cgaDrawText(x, y, layout->length, layout->content);
+    return;
+  }
+
+  profileBegin("cgaDrawLayout");
+  cgaBatchQuadRun(fontTextureId, layout->vertices, layout->quadCount, x, y);
+  profileEnd();
+}
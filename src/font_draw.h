@@ -1,11 +1,30 @@
 #ifndef FONT_DRAW_H
 #define FONT_DRAW_H
 
-#define CHAR_DIF_X 8.5f
-#define CHAR_DIF_Y 8.5f
-
-#define CH_BASE_X_SCALE 0.015
-#define CH_BASE_Y_SCALE 0.015
+#include "cga_core.h"
+#include "cga_batch.h"
+#include "font_glyphs.h"
+
+typedef enum {
+  // One textured quad per character from the glyph atlas
+  TEXT_MODE_ATLAS,
+  // One quad per set pixel of the 8x8 bitmap, kept for comparison
+  TEXT_MODE_PIXELS
+} text_draw_mode_t;
+
+// Measured extents and glyph quads of a string, positioned relative to the
+// point the text is drawn at
+typedef struct TextLayout {
+  float width;
+  float height;
+  int lines;
+
+  int quadCount;
+  batch_vertex_t* vertices;
+
+  const char* content;
+  int length;
+} text_layout_t;
 
 typedef int(*char_callback_t)(char ch, int chIndex, float* x, float* y);
 
@@ -15,6 +34,8 @@ boolean cgaInitTextDraw();
 
 void cgaCloseTextDraw();
 
+void cgaSetTextDrawMode(text_draw_mode_t mode);
+
 void cgaSetTextScale(float xScale, float yScale);
 
 void cgaSetCharDrawCallback(char_callback_t callback);
@@ -23,4 +44,12 @@ void cgaDrawText(float x, float y, int maxbufSize, const char* content);
 
 void cgaMeasureText(int maxBufSize, const char* content, float* width, float* height, int* lines);
 
+// Measures and tessellates a string at the current text scale in one pass.
+// Layouts are cached by content and scale, so unchanged text costs a hash
+// lookup. The pointer stays valid until the next cgaLayoutText call.
+const text_layout_t* cgaLayoutText(int maxBufSize, const char* content);
+
+// Draws a layout with its origin at (x, y) in the current batch colour
+void cgaDrawLayout(const text_layout_t* layout, float x, float y);
+
 #endif // FONT_DRAW_H
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef FONT_GLYPHS_H
+#define FONT_GLYPHS_H
+
+// 8x8 bitmap font shared by the GL text renderer and the software
+// rasteriser. Bit x of row y is the pixel x columns from the left.
+
+#define CHAR_SIZE 8
+#define CHARS 128
+
+#define CHAR_DIF_X 8.5f
+#define CHAR_DIF_Y 8.5f
+
+#define CH_BASE_X_SCALE 0.015
+#define CH_BASE_Y_SCALE 0.015
+
+extern const char font8x8_basic[CHARS][CHAR_SIZE];
+
+#endif // FONT_GLYPHS_H
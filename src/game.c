@@ -10,23 +10,34 @@
 #include "font_draw.h"
 #include "log.h"
 #include "cga_render.h"
+#include "cga_batch.h"
+#include "game_rules.h"
+#include "game_replay.h"
+#include "game_solver.h"
+#include "tile_render.h"
+#include "cga_layer.h"
+#include "cga_capture.h"
+#include "cga_gpu_timer.h"
+#include "cga_binlog.h"
+#include "cga_profile.h"
+#include "cga_gl_state.h"
 
-#define BOARD_WIDTH 4
-#define BOARD_HEIGHT 4
-#define BOARD_SIZE (BOARD_HEIGHT * BOARD_WIDTH)
 #define MOVE_TIME_SECS 0.5
-#define DEBUG_INFO_BUF_SIZE 100
+#define DEBUG_INFO_BUF_SIZE 1024
+#define FRAME_GRAPH_WIDTH 0.5f
+#define FRAME_GRAPH_HEIGHT 0.2f
 #define TARGET_VALUE 2048.0f
 #define SCORE_BUF_LEN 20
+#define REPLAY_PATH_LEN 64
+#define GAME_FRAME_CAP 60
+#define LOG_RING_SIZE 1024
+#define BINLOG_ENV "CGA_BINLOG"
+#define PROFILE_ENV "CGA_PROFILE_TRACE"
+#define PROFILE_PATH "profile.json"
+#define RENDER_THREAD_ENV "CGA_RENDER_THREAD"
 
-#define TO_INDEX(x, y) ((BOARD_WIDTH * x) + y)
-#define IN_BOUNDS(x, y) ((x >= 0 && x < BOARD_WIDTH) && (y >= 0 && y < BOARD_HEIGHT))
 #define LERP(prog, a, b) (a + ((b - a) * prog))
 
-#define NO_CELL_VALUE 0
-#define STARTING_VALUE 2
-#define OUT_OF_BOUNDS -1
-
 typedef enum {
   GS_INACTIVE,
   GS_ACTIVE,
@@ -34,241 +45,132 @@ typedef enum {
   GS_LOST
 } game_state_t;
 
+// Batch layers, quads on higher ones are drawn over lower ones whatever
+// order they're submitted in
 typedef enum {
-  DIR_UP,
-  DIR_DOWN,
-  DIR_LEFT,
-  DIR_RIGHT
-} shift_direction_t;
+  LAYER_BACK,
+  LAYER_MIDDLE,
+  LAYER_FRONT
+} draw_layer_t;
+
+// Everything drawing needs, written by the sim and drawn by the frame
+// callbacks, which may run on the render thread
+typedef struct GameSnapshot {
+  board_t board;
+  int score;
+  game_state_t state;
+  // Changes whenever the retained scene has to be redrawn
+  int sceneVersion;
+  boolean debugInfo;
+} game_snapshot_t;
 
 static game_state_t gameState = GS_INACTIVE;
-static int board[BOARD_SIZE] = {0};
+static game_context game = null;
+static replay_writer replay = null;
 static float gameTime = 0.0f;
-static boolean debugInfoEnabled = true;
+static boolean debugInfoEnabled = false;
 
 static char* debugBuffer = NULL;
 
-static int freeSlots[BOARD_SIZE] = {0};
-static int freeSlotCount = 0;
-
-static int score = 0;
 static int hiScore = 0;
 static char scoreBuf[SCORE_BUF_LEN] = {0};
-
-static void findFreeSlots() {
-  freeSlotCount = 0;
-  
-  for (int i = 0; i < BOARD_SIZE; i++) {
-    int v = board[i];
-
-    if (v != NO_CELL_VALUE) {
-      continue;
-    }
-
-    freeSlots[freeSlotCount++] = i;
-  }
+static int shownScore = -1;
+
+// Tile colours by exponent, 0 is an empty cell
+static const uint8_t tilePalette[TILE_PALETTE_SIZE][3] = {
+  {127, 127, 127},
+  {238, 228, 218},
+  {237, 224, 200},
+  {242, 177, 121},
+  {245, 149, 99},
+  {246, 124, 95},
+  {246, 94, 59},
+  {237, 207, 114},
+  {237, 204, 97},
+  {237, 200, 80},
+  {237, 197, 63},
+  {237, 194, 46},
+  {60, 58, 50},
+  {60, 58, 50},
+  {60, 58, 50},
+  {60, 58, 50}
+};
+
+// Null when the context has no core profile, the board is drawn as
+// batched quads then
+static tile_renderer tiles = null;
+static float tileLayoutRatio = 0;
+
+// Board, score and titles only change on moves, game state changes and
+// resizes, in between frames just blit this. Null without FBO support.
+static render_layer sceneLayer = null;
+static int sceneRebuilds = 0;
+// Sim side version and the one the layer holds
+static int sceneVersion = 0;
+static int drawnSceneVersion = -1;
+
+static void invalidateScene() {
+  sceneVersion++;
 }
 
-static void resetBoard() {
-  for (int i = 0; i < BOARD_SIZE; i++) {
-    board[i] = NO_CELL_VALUE;
-  }
-}
+static void publishSnapshot() {
+  game_snapshot_t* snapshot = cgaSnapshotBegin();
 
-static int getCell(int x, int y) {
-  if (!IN_BOUNDS(x, y)) {
-    return OUT_OF_BOUNDS;
+  if (snapshot == null) {
+    return;
   }
 
-  int index = TO_INDEX(x, y);
-  return board[index];
+  *snapshot = (game_snapshot_t) {
+    .board = gameGetBoard(game),
+    .score = gameGetScore(game),
+    .state = gameState,
+    .sceneVersion = sceneVersion,
+    .debugInfo = debugInfoEnabled
+  };
+
+  cgaSnapshotPublish();
 }
 
-static void setCell(int x, int y, int value) {
-  if (!IN_BOUNDS(x, y)) {
+// Writes the current game's replay to the working directory, named by seed
+static void saveReplay() {
+  if (replay == null || replay->moveCount == 0) {
     return;
   }
 
-  int index = TO_INDEX(x, y);
+  char path[REPLAY_PATH_LEN];
+  snprintf(path, REPLAY_PATH_LEN, "replay_%016llx.c2r", (unsigned long long) replay->seed);
 
-  int prevValue = board[index];
-
-  if (value <= 0) {
-    board[index] = NO_CELL_VALUE;
+  if (replay->failed) {
+    logWarnF("Out of memory while recording, not saving incomplete replay %s", path);
+  } else if (replayWriterSave(replay, path)) {
+    logDebugF("Saved replay to %s", path);
   } else {
-    board[index] = value;
+    logErrorF("Failed to save replay to %s", path);
   }
-}
 
-static boolean genRandomSlot();
+  replay->moveCount = 0;
+}
 
 static void startGame() {
-  resetBoard();
+  saveReplay();
+  gameReset(game);
+
+  if (replay != null) {
+    replayWriterBegin(replay, game);
+  }
+
   gameState = GS_ACTIVE;
+  invalidateScene();
 
-  genRandomSlot();
-  genRandomSlot();
+  logDebugF("Game started, seed=%llu", (unsigned long long) gameGetSeed(game));
 }
 
 static void setGameLost() {
   gameState = GS_LOST;
+  invalidateScene();
   logDebug("Game lost!");
-}
-
-static boolean isGameLost() {
-  for (int x = 0; x < BOARD_WIDTH; x++) {
-    for (int y = 0; y < BOARD_HEIGHT; y++) {
-      int v = getCell(x, y);
-
-      if (v == NO_CELL_VALUE) {
-        return false;
-      }
-
-      int b = getCell(x, y + 1);
-      int a = getCell(x, y - 1);
-      int l = getCell(x + 1, y);
-      int r = getCell(x - 1, y);
-
-      if (b == v || a == v || l == v || r == v) {
-        return false;
-      }
-    }
-  }
-
-  return true;
-}
-
-static boolean genRandomSlot() {
-  findFreeSlots();
-
-  if (freeSlotCount == 0) {
-    return false;
-  }
-
-  int rValue = rand();
-  float local = rValue / (float) RAND_MAX;
-  int index = (int) (local * freeSlotCount);
-
-  int boardSlot = freeSlots[index];
-
-  board[boardSlot] = STARTING_VALUE;
-  return true;
-}
-
-static int shiftCell(int x, int y, int moveX, int moveY) {
-  if (moveX == 0 && moveY == 0) {
-    printf("[ERROR] Both move X and move Y are 0\n");
-    return false;
-  }
-
-  int startVal = getCell(x, y);
-
-  if (startVal == NO_CELL_VALUE) {
-    return false;
-  }
-
-  setCell(x, y, NO_CELL_VALUE);
-
-  int nextX = x;
-  int nextY = y;
-
-  int wasMoved = 0;
-
-  while (1) {
-    nextX = x + moveX;
-    nextY = y + moveY;
-
-    int v = getCell(nextX, nextY);
-
-    if (v == OUT_OF_BOUNDS) {
-      setCell(x, y, startVal);
-      break;
-    }
-
-    if (v == NO_CELL_VALUE) {
-      x = nextX;
-      y = nextY;
-      wasMoved = 1;
-
-      continue;
-    }
-
-    if (v == startVal) {
-      int nval = v + startVal;
-      setCell(nextX, nextY, nval);
-      score += nval;
-      break;
-    }
-
-    setCell(x, y, startVal);
-    break;
-  }
-}
-
-static int shiftX(shift_direction_t dir) {
-  int moveDir = 0;
-  int start = 0;
-  int shiftDir = 0;
-
-  switch (dir) {
-    case DIR_RIGHT:
-      moveDir = 1;
-      shiftDir = -1;
-      start = 1;
-      break;
-
-    case DIR_LEFT:
-      moveDir = -1;
-      shiftDir = 1;
-      start = BOARD_WIDTH - 1;
-      break;
-
-    default:
-      return 0;
-  }
-
-  int moved = 0;
-
-  for (int y = 0; y < BOARD_HEIGHT; y++) {
-    for (int x = start; x >= 0 && x < BOARD_WIDTH; x += moveDir) {
-      moved += shiftCell(x, y, shiftDir, 0);
-    }
-  }
-
-  return moved;
-}
-
-static int shiftY(shift_direction_t dir) {
-  int moveDir = 0;
-  int start = 0;
-  int shiftDir = 0;
-
-  switch (dir) {
-    case DIR_DOWN:
-      shiftDir = 1;
-      moveDir = -1;
-      start = BOARD_HEIGHT - 1;
-      break;
-    
-    case DIR_UP:
-      shiftDir = -1;
-      moveDir = 1;
-      start = 1;
-      break;
-
-    default:
-      return 0;
-  }
-
-  int moved = 0;
 
-  for (int x = 0; x < BOARD_WIDTH; x++) {
-    for (int y = start; y >= 0 && y < BOARD_HEIGHT; y += moveDir) {
-      moved += shiftCell(x, y, 0, shiftDir);
-    }
-  }
-
-  return moved;
+  saveReplay();
 }
 
 static void shiftInDirection(shift_direction_t dir) {
@@ -276,23 +178,21 @@ static void shiftInDirection(shift_direction_t dir) {
     return;
   }
 
-  int movedPieces = 0;
+  profileBegin("shiftInDirection");
 
-  if (dir == DIR_DOWN || dir == DIR_UP) {
-    movedPieces = shiftY(dir);
-  } else {
-    movedPieces = shiftX(dir);
-  }
-
-  if (movedPieces == 0) {
-    return;
-  }
+  if (gameMove(game, dir)) {
+    if (replay != null) {
+      replayWriterRecord(replay, game, dir);
+    }
 
-  genRandomSlot();
+    invalidateScene();
 
-  if (isGameLost()) {
-    setGameLost();
+    if (gameIsLost(game)) {
+      setGameLost();
+    }
   }
+
+  profileEnd();
 }
 
 static void onInput(int key, int action, int mods) {
@@ -310,6 +210,10 @@ static void onInput(int key, int action, int mods) {
       debugInfoEnabled = true;
     }
 
+    cgaSetGpuPhaseTimers(debugInfoEnabled);
+    return;
+  } else if (key == KEY_F4) {
+    cgaProfileExport(PROFILE_PATH);
     return;
   }
 
@@ -356,7 +260,85 @@ static void onInput(int key, int action, int mods) {
   }
 }
 
-static void printDebugInfo(float deltaTime) {
+// Recent frame times as bars, newest on the right. The white line is the
+// frame budget at half height, taller bars are hitches.
+static void drawFrameGraph(float x, float y) {
+  const frame_times_t* times = cgaGetFrameTimes();
+  float barWidth = FRAME_GRAPH_WIDTH / FRAME_TIMES_CAPACITY;
+  float bottom = y - FRAME_GRAPH_HEIGHT;
+
+  cgaBatchSetLayer(LAYER_BACK);
+  cgaBatchSetColor3f(0.1f, 0.1f, 0.1f);
+  drawQuad(x, y, x + FRAME_GRAPH_WIDTH, bottom);
+
+  cgaBatchSetLayer(LAYER_MIDDLE);
+
+  for (int age = 0; age < times->count; age++) {
+    double frameTime = cgaFrameTimesGet(times, age);
+    float height = (float) (frameTime / (2 * times->budget)) * FRAME_GRAPH_HEIGHT;
+    float barX = x + FRAME_GRAPH_WIDTH - (age + 1) * barWidth;
+
+    if (height > FRAME_GRAPH_HEIGHT) {
+      height = FRAME_GRAPH_HEIGHT;
+    }
+
+    if (frameTime > times->budget) {
+      cgaBatchSetColor3f(0.9f, 0.2f, 0.1f);
+    } else {
+      cgaBatchSetColor3f(0.0f, 0.75f, 0.0f);
+    }
+
+    drawQuad(barX, bottom, barX + barWidth, bottom + height);
+  }
+
+  float budgetY = bottom + FRAME_GRAPH_HEIGHT / 2;
+
+  cgaBatchSetLayer(LAYER_FRONT);
+  cgaBatchSetColor3f(1.0f, 1.0f, 1.0f);
+  drawQuad(x, budgetY, x + FRAME_GRAPH_WIDTH, budgetY - 0.005f);
+}
+
+// One row per loop phase, GPU time is blank for phases without GL work or
+// while the timer results are still in flight
+static int printPhaseTimes(char* out, int size) {
+  frame_phase_times_t phases;
+  cgaGetFramePhaseTimes(&phases);
+
+  double gpuTotal = 0;
+  int written = snprintf(out, size, "Phase        CPU ms  GPU ms");
+
+  for (int i = 0; i < FRAME_PHASE_COUNT && written > 0 && written < size; i++) {
+    int n;
+
+    if (phases.gpu[i] >= 0) {
+      n = snprintf(out + written, size - written, "\n%-11s %6.2f  %6.2f",
+        cgaGetFramePhaseName(i), phases.cpu[i], phases.gpu[i]
+      );
+      gpuTotal += phases.gpu[i];
+    } else {
+      n = snprintf(out + written, size - written, "\n%-11s %6.2f",
+        cgaGetFramePhaseName(i), phases.cpu[i]
+      );
+    }
+
+    written = n > 0 ? written + n : -1;
+  }
+
+  if (written > 0 && written < size) {
+    int n = snprintf(out + written, size - written, "\nGPU frame: %.2fms", gpuTotal);
+    written = n > 0 ? written + n : -1;
+  }
+
+  // Never negative, an encoding error keeps nothing of this block
+  if (written < 0) {
+    out[0] = '\0';
+    return 0;
+  }
+
+  return written < size ? written : size - 1;
+}
+
+static void printDebugInfo() {
   if (debugBuffer == NULL) {
     debugBuffer = malloc(DEBUG_INFO_BUF_SIZE);
 
@@ -366,85 +348,99 @@ static void printDebugInfo(float deltaTime) {
     }
   }
 
-  float fps = cgaGetFps();
-  int frameCounter = cgaGetFrameCounter();
-  int printedChars = sprintf_s(debugBuffer, DEBUG_INFO_BUF_SIZE, "FPS: %.0f\nDeltaTime: %fs", fps, deltaTime);
+  frame_time_stats_t frameStats;
+  cgaGetFrameTimeStats(&frameStats);
+
+  batch_stats_t batchStats;
+  cgaBatchGetStats(&batchStats);
+
+  batch_stats_t overlayStats;
+  cgaBatchGetOverlayStats(&overlayStats);
+
+  gl_state_stats_t glStats;
+  cgaGlStateGetStats(&glStats);
+
+  gl_state_stats_t glOverlayStats;
+  cgaGlStateGetOverlayStats(&glOverlayStats);
+
+  frame_time_stats_t latency;
+  cgaGetInputLatencyStats(&latency);
+
+  sim_stats_t simStats;
+  cgaGetSimStats(&simStats);
+
+  int printedChars = snprintf(debugBuffer, DEBUG_INFO_BUF_SIZE,
+    "FPS: %.0f\nFrame: mean %.2fms p50 %.2fms\np95 %.2fms p99 %.2fms\nMax: %.2fms Hitches: %i/%i\n"
+    "Draws: %i Cmds: %i Quads: %i Verts: %i\nTexture changes: %i\nUpload: %.1fKB, %i stalls\n"
+    "GL calls: %i issued, %i elided\n"
+    "Scene rebuilds: %i\nOverlay: %i draws, %i quads\n%i GL calls, %i elided\n"
+    "Input: p50 %.1fms p95 %.1fms\nSnapshots skipped: %llu\n",
+    cgaGetFps(), frameStats.mean * 1e3, frameStats.p50 * 1e3,
+    frameStats.p95 * 1e3, frameStats.p99 * 1e3,
+    frameStats.max * 1e3, frameStats.hitches, frameStats.frames,
+    batchStats.drawCalls, batchStats.commands, batchStats.quads, batchStats.vertices, batchStats.textureChanges,
+    batchStats.uploadBytes / 1024.0f, batchStats.uploadStalls,
+    glStats.issued, glStats.elided, sceneRebuilds,
+    overlayStats.drawCalls, overlayStats.quads, glOverlayStats.issued, glOverlayStats.elided,
+    latency.p50 * 1e3, latency.p95 * 1e3, (unsigned long long) simStats.skipped
+  );
+
+  if (printedChars > 0 && printedChars < DEBUG_INFO_BUF_SIZE) {
+    printedChars += printPhaseTimes(debugBuffer + printedChars, DEBUG_INFO_BUF_SIZE - printedChars);
+  } else if (printedChars >= DEBUG_INFO_BUF_SIZE) {
+    printedChars = DEBUG_INFO_BUF_SIZE - 1;
+  }
+
+  if (printedChars < 1) {
+    return;
+  }
 
-  float width = 0;
-  float height = 0;
-  
   cgaSetTextScale(0.5f, 0.5f);
-  cgaMeasureText(DEBUG_INFO_BUF_SIZE, debugBuffer, &width, &height, null);
+  const text_layout_t* layout = cgaLayoutText(printedChars, debugBuffer);
 
   float qX = -1.0f;
   float qY = 1.0f;
 
-  glColor3f(0.0f, 0.75f, 0);
-  drawQuad(qX, qY, qX + width, qY - height);
+  cgaBatchSetLayer(LAYER_BACK);
+  cgaBatchSetColor3f(0.0f, 0.75f, 0);
+  drawQuad(qX, qY, qX + layout->width, qY - layout->height);
 
-  if (printedChars > 0) {
-    glColor3f(1.0f, 1.0f, 1.0f);
-    cgaDrawText(-1.0f, 1.0f, printedChars, debugBuffer);
-  }
+  cgaBatchSetLayer(LAYER_FRONT);
+  cgaBatchSetColor3f(1.0f, 1.0f, 1.0f);
+  cgaDrawLayout(layout, qX, qY);
+
+  drawFrameGraph(qX, qY - layout->height);
 }
 
 static void drawCellValue() {
 
 }
 
-static void setColor(int cellValue) {
-  switch (cellValue) {
-    case STARTING_VALUE:
-      glColor3ub(238, 228, 218);
-      break;
-
-    case 4:
-      glColor3ub(237, 224, 200);
-      break;
-
-    case 8:
-      glColor3ub(242, 177, 121);
-      break;
-
-    case 16:
-      glColor3ub(245, 149, 99);
-      break;
-
-    case 32:
-      glColor3ub(246, 124, 95);
-      break;
-
-    case 64:
-      glColor3ub(246, 94, 59);
-      break;
-
-    case 128:
-      glColor3ub(237, 207, 114);
-      break;
-
-    case 256:
-      glColor3ub(237, 204, 97);
-      break;
+static void setTileColor(int exponent) {
+  const uint8_t* color = tilePalette[exponent];
+  cgaBatchSetColor3ub(color[0], color[1], color[2]);
+}
 
-    case 512:
-      glColor3ub(237, 200, 80);
-      break;
+static void drawTilesInstanced(float ratio, const tile_layout_t* layout, board_t board) {
+  if (ratio != tileLayoutRatio) {
+    cgaTilesSetLayout(tiles, layout);
+    tileLayoutRatio = ratio;
+  }
 
-    case 1024:
-      glColor3ub(237, 197, 63);
-      break;
+  tile_instance_t instances[BOARD_SIZE];
 
-    case 2048:
-      glColor3ub(237, 194, 46);
-      break;
-    
-    default:
-      glColor3ub(60, 58, 50);
-      break;
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    instances[i] = (tile_instance_t) {
+      .cell = (uint8_t) i,
+      .exponent = (uint8_t) boardGetExponent(board, i),
+      .scale = 1.0f
+    };
   }
+
+  cgaTilesDraw(tiles, instances, BOARD_SIZE);
 }
 
-static void drawBoard(float ratio) {
+static void drawBoard(float ratio, board_t board) {
   float startX = 0.5;
   float startY = 0.5 * ratio;
   float endX = -0.5;
@@ -460,31 +456,43 @@ static void drawBoard(float ratio) {
   char scoreBuffer[bufSize];
   int wrote = 0;
 
+  if (tiles != null) {
+    tile_layout_t layout = {
+      .originX = startX + shrinkX,
+      .originY = startY + shrinkY,
+      .stepX = cellSizeX,
+      .stepY = cellSizeY,
+      .sizeX = cellSizeX - shrinkX,
+      .sizeY = cellSizeY - shrinkY,
+      .columnLength = BOARD_WIDTH
+    };
+
+    drawTilesInstanced(ratio, &layout, board);
+  }
+
   for (int x = 0; x < BOARD_WIDTH; x++) {
     for (int y = 0; y < BOARD_HEIGHT; y++) {
-      int cellValue = getCell(x, y);
-
-      if (cellValue != NO_CELL_VALUE) {
-        setColor(cellValue);
-      } else {
-        glColor3f(0.5f, 0.5f, 0.5f);
-      }
+      int cellValue = boardGetValue(board, TO_INDEX(x, y));
 
       float cStartX = startX + (x * cellSizeX) + shrinkX;
       float cStartY = startY + (y * cellSizeY) + shrinkY;
-      float cEndX = cStartX + cellSizeX - shrinkX;
-      float cEndY = cStartY + cellSizeY - shrinkY;
 
-      drawQuad(cStartX, cStartY, cEndX, cEndY);
+      if (tiles == null) {
+        cgaBatchSetLayer(LAYER_BACK);
+        setTileColor(boardGetExponent(board, TO_INDEX(x, y)));
+        drawQuad(cStartX, cStartY, cStartX + cellSizeX - shrinkX, cStartY + cellSizeY - shrinkY);
+      }
 
       if (cellValue != NO_CELL_VALUE) {
+        cgaBatchSetLayer(LAYER_FRONT);
+
         if (cellValue < 8) {
-          glColor3ub(119, 110, 101);
+          cgaBatchSetColor3ub(119, 110, 101);
         } else {
-          glColor3f(1.0f, 1.0f, 1.0f);
+          cgaBatchSetColor3f(1.0f, 1.0f, 1.0f);
         }
 
-        wrote = sprintf_s(scoreBuffer, bufSize, "%i", cellValue);
+        wrote = snprintf(scoreBuffer, bufSize, "%i", cellValue);
 
         if (wrote < 1) {
           continue;
@@ -496,53 +504,64 @@ static void drawBoard(float ratio) {
 
         cgaSetTextScale(cSizeX, cSizeY);
 
-        cgaDrawText(
+        cgaDrawLayout(
+          cgaLayoutText(wrote, scoreBuffer),
           (cStartX + cellSizeX - (shrinkX * 2.5f) + textShiftX),
-          cStartY + shrinkY + textShiftX,
-          bufSize,
-          scoreBuffer
+          cStartY + shrinkY + textShiftX
         );
       }
     }
   }
 }
 
-static void drawScore(float ratio) {
-  int len = sprintf_s(scoreBuf, SCORE_BUF_LEN, "Score: %i", score);
+static void drawScore(float ratio, int score) {
+  // Only reformat when the score changed, the layout is cached by content
+  if (score != shownScore) {
+    int len = snprintf(scoreBuf, SCORE_BUF_LEN, "Score: %i", score);
 
-  if (len < 1) {
-    logError("Error writing to score text buffer");
-    return;
+    if (len < 1) {
+      logError("Error writing to score text buffer");
+      return;
+    }
+
+    shownScore = score;
   }
 
   cgaSetTextScale(1, ratio);
-  glColor3f(0.0f, 1.0f, 0.0f);
+  cgaBatchSetLayer(LAYER_FRONT);
+  cgaBatchSetColor3f(0.0f, 1.0f, 0.0f);
 
-  cgaDrawText(-0.95f, -0.85f, SCORE_BUF_LEN, scoreBuf);
+  cgaDrawLayout(cgaLayoutText(SCORE_BUF_LEN, scoreBuf), -0.95f, -0.85f);
 }
 
 static void drawCenteredText(float y, int textLen, char* content) {
   cgaSetTextScale(1, 1);
 
-  float width = 0;
-  cgaMeasureText(textLen, content, &width, null, null);
-
-  float x = 0 - (width / 2.0f);
+  // Shadow and text share one layout, only the offset differs
+  const text_layout_t* layout = cgaLayoutText(textLen, content);
+  float x = 0 - (layout->width / 2.0f);
   
-  glColor3f(0.0f, 0.5f, 0.0f);
-  cgaDrawText(x + CH_BASE_X_SCALE, y - CH_BASE_Y_SCALE, textLen, content);
+  cgaBatchSetLayer(LAYER_MIDDLE);
+  cgaBatchSetColor3f(0.0f, 0.5f, 0.0f);
+  cgaDrawLayout(layout, x + CH_BASE_X_SCALE, y - CH_BASE_Y_SCALE);
 
-  glColor3f(0, 1, 0);
-  cgaDrawText(x, y, textLen, content);
+  cgaBatchSetLayer(LAYER_FRONT);
+  cgaBatchSetColor3f(0, 1, 0);
+  cgaDrawLayout(layout, x, y);
 }
 
-void onUpdate(float deltaTime, float ratio) {
-  gameTime += deltaTime;
+static void drawScene(float ratio, const game_snapshot_t* snapshot) {
+  sceneRebuilds++;
 
-  drawBoard(ratio);
-  drawScore(ratio);
+  profileBegin("drawBoard");
+  drawBoard(ratio, snapshot->board);
+  profileEnd();
 
-  if (gameState == GS_LOST) {
+  profileBegin("drawScore");
+  drawScore(ratio, snapshot->score);
+  profileEnd();
+
+  if (snapshot->state == GS_LOST) {
     char* youLost = "You lose!";
     char* restart = "'R' to restart";
 
@@ -551,10 +570,62 @@ void onUpdate(float deltaTime, float ratio) {
   } else {
     drawCenteredText(0.75f, 6, "2048");
   }
+}
+
+// Advances the game on the main thread and hands its state to drawing
+static void onSim(float deltaTime, float ratio) {
+  gameTime += deltaTime;
+  publishSnapshot();
+}
+
+// Only draws the snapshot, the game may be changing on another thread
+void onUpdate(float deltaTime, float ratio) {
+  const game_snapshot_t* snapshot = cgaGetSnapshot();
+
+  if (snapshot == null) {
+    return;
+  }
+
+  if (sceneLayer == null) {
+    drawScene(ratio, snapshot);
+  } else {
+    int width = 0;
+    int height = 0;
+    cgaGetFramebufferSize(&width, &height);
+
+    if (snapshot->sceneVersion != drawnSceneVersion) {
+      cgaLayerInvalidate(sceneLayer);
+      drawnSceneVersion = snapshot->sceneVersion;
+    }
+
+    if (!cgaLayerIsValid(sceneLayer, width, height)) {
+      cgaLayerBegin(sceneLayer, width, height);
+      drawScene(ratio, snapshot);
+      cgaLayerEnd(sceneLayer);
+    }
+
+    profileBegin("cgaLayerBlit");
+    cgaLayerBlit(sceneLayer);
+    profileEnd();
+  }
 
-  if (debugInfoEnabled) {
-    printDebugInfo(deltaTime);
+}
+
+// Drawn after the scene so the HUD's own quads aren't in the batch counters
+// it shows, and with the atlas as solid texture it's a single draw call
+static void onOverlay(float deltaTime, float ratio) {
+  const game_snapshot_t* snapshot = cgaGetSnapshot();
+
+  if (snapshot == null || !snapshot->debugInfo) {
+    return;
   }
+
+  profileBegin("printDebugInfo");
+  printDebugInfo();
+  profileEnd();
+
+  // Keep the counters live, the frame cap bounds the cost
+  cgaRequestRedraw();
 }
 
 static void bufferTest() {
@@ -589,24 +660,370 @@ static void bufferTest() {
   cgaFreeVertexBuffer(buf);
 }
 
-void gameMain() {
+// Window, renderers and a game, shared by gameMain and gameBenchmark
+static boolean gameSetup(game_context ctx) {
+  // Keeps stdio off the render thread
+  cgaLogStartAsync(LOG_RING_SIZE);
+
+  const char* binlogPath = getenv(BINLOG_ENV);
+
+  if (binlogPath != null && cgaBinLogOpen(binlogPath)) {
+    logInfoF("Writing debug messages to %s, decode with log_decode", binlogPath);
+  }
+
+  const char* tracePath = getenv(PROFILE_ENV);
+
+  if (tracePath != null) {
+    cgaProfileExportAtExit(tracePath);
+  }
+
+  if (ctx == null) {
+    logError("Failed to allocate game context");
+    return false;
+  }
+
   if (!cgaInit()) {
-    return;
+    gameFree(ctx);
+    return false;
+  }
+
+  if (!cgaSetSnapshotSize(sizeof(game_snapshot_t))) {
+    logError("Failed to allocate game snapshots");
+    cgaClose();
+    gameFree(ctx);
+    return false;
   }
 
   cgaSetKeyCallback(onInput);
+  cgaSetSimCallback(onSim);
   cgaSetFrameCallback(onUpdate);
+  cgaSetOverlayCallback(onOverlay);
   cgaInitTextDraw();
   cgaSetScreenTitle("2048");
-  cgaSetScreenSize(800, 800);
   cgaSetVsync(false);
 
+  game = ctx;
+
+  tiles = cgaTilesCreate(BOARD_SIZE);
+  sceneLayer = cgaLayerCreate();
+
+  if (tiles != null) {
+    cgaTilesSetPalette(tiles, tilePalette, TILE_PALETTE_SIZE);
+    logDebug("Drawing the board with instanced tiles");
+  }
+
+  return true;
+}
+
+static void gameTeardown() {
+  cgaTilesFree(tiles);
+  cgaLayerFree(sceneLayer);
+  tiles = null;
+  sceneLayer = null;
+
+  cgaCloseTextDraw();
+  cgaClose();
+
+  saveReplay();
+  replayWriterFree(replay);
+  replay = null;
+
+  gameFree(game);
+  game = null;
+
+  cgaBinLogClose();
+  cgaLogStopAsync();
+}
+
+void gameMain() {
+  if (!gameSetup(gameCreate())) {
+    return;
+  }
+
+  cgaSetScreenSize(800, 800);
+
+  // The board only changes on input, don't burn a core redrawing it
+  cgaSetLoopMode(LOOP_ON_DEMAND);
+
+  if (getenv(RENDER_THREAD_ENV) != null) {
+    cgaSetThreadMode(THREAD_MODE_RENDER_THREAD);
+    logInfo("Drawing on a render thread");
+  }
+  cgaSetFrameCap(GAME_FRAME_CAP);
+
+  replay = replayWriterCreate(REPLAY_DEFAULT_CHECKPOINT_INTERVAL);
+
+  if (replay == null) {
+    logWarn("Failed to allocate replay writer, games won't be recorded");
+  }
+
   bufferTest();
 
   startGame();
 
   cgaLoop();
 
-  cgaClose();
-  cgaCloseTextDraw();
-}
\ No newline at end of file
+  gameTeardown();
+}
+
+// Benchmark mode
+
+#define BENCH_SEED 2048
+#define BENCH_PATH_LEN 256
+// Sim ticks per second with a render thread, moves land every
+// moveInterval ticks
+#define BENCH_SIM_RATE 240
+#define BENCH_SOLVER_TABLE_MB 16
+
+static const game_bench_options_t* benchOptions = null;
+static gpu_timer benchGpuTimer = null;
+static double* benchCpuTimes = null;
+static double* benchGpuTimes = null;
+static int benchGpuSamples = 0;
+static int benchFrame = 0;
+static int benchTick = 0;
+static solver benchSolver = null;
+static double benchFrameStart = 0;
+static long benchMismatches = 0;
+// Sums over the finished frames, the last frame's counters land after the loop
+static gl_state_stats_t benchGlStats = {0};
+
+// Corner strategy, the first direction that changes the board
+static void playScriptedMove() {
+  static const shift_direction_t priority[DIRECTION_COUNT] = {DIR_UP, DIR_LEFT, DIR_RIGHT, DIR_DOWN};
+
+  if (gameState == GS_LOST) {
+    startGame();
+    return;
+  }
+
+  if (benchSolver != null) {
+    int best = solverBestMove(benchSolver, gameGetBoard(game), benchOptions->solverDepth, null, null);
+
+    if (best != SOLVER_NO_MOVE) {
+      shiftInDirection((shift_direction_t) best);
+      return;
+    }
+  }
+
+  int moves = gameGetMoveCount(game);
+
+  for (int i = 0; i < DIRECTION_COUNT && gameGetMoveCount(game) == moves; i++) {
+    shiftInDirection(priority[i]);
+  }
+}
+
+static void collectGpuTimes(boolean wait) {
+  double ms;
+
+  while (benchGpuSamples < benchFrame && (ms = cgaGpuTimerCollect(benchGpuTimer, wait)) >= 0) {
+    benchGpuTimes[benchGpuSamples++] = ms;
+  }
+}
+
+// The move counts as input from before the move is picked, so the latency
+// includes the game logic
+static void onBenchSim(float deltaTime, float ratio) {
+  if (benchTick % benchOptions->moveInterval == 0) {
+    cgaNoteInput();
+    playScriptedMove();
+  }
+
+  benchTick++;
+  onSim(deltaTime, ratio);
+}
+
+static void onBenchFrame(float deltaTime, float ratio) {
+  benchFrameStart = cgaGetTime();
+  cgaGpuTimerBegin(benchGpuTimer);
+
+  if (benchFrame > 0) {
+    gl_state_stats_t glStats;
+    cgaGlStateGetStats(&glStats);
+    benchGlStats.issued += glStats.issued;
+    benchGlStats.elided += glStats.elided;
+    benchGlStats.drawCalls += glStats.drawCalls;
+  }
+
+  onUpdate(deltaTime, ratio);
+}
+
+static void dumpFrame() {
+  char path[BENCH_PATH_LEN];
+  int width = 0;
+  int height = 0;
+
+  cgaGetFramebufferSize(&width, &height);
+
+  if (benchOptions->goldenDir != null) {
+    snprintf(path, BENCH_PATH_LEN, "%s/frame_%05i.ppm", benchOptions->goldenDir, benchFrame);
+    long mismatched = cgaCompareFrame(path, width, height, 0);
+
+    if (mismatched != 0) {
+      logErrorF("Frame %i differs from %s (%li pixels)", benchFrame, path, mismatched);
+      benchMismatches++;
+    }
+  }
+
+  if (benchOptions->dumpDir != null) {
+    snprintf(path, BENCH_PATH_LEN, "%s/frame_%05i.ppm", benchOptions->dumpDir, benchFrame);
+
+    if (!cgaCaptureFrame(path, width, height)) {
+      logErrorF("Failed to dump frame to %s", path);
+    }
+  }
+}
+
+static void onBenchFrameEnd(float deltaTime, float ratio) {
+  cgaGpuTimerEnd(benchGpuTimer);
+  benchCpuTimes[benchFrame] = (cgaGetTime() - benchFrameStart) * 1e3;
+
+  if (benchOptions->dumpInterval > 0 && benchFrame % benchOptions->dumpInterval == 0) {
+    dumpFrame();
+  }
+
+  benchFrame++;
+  collectGpuTimes(false);
+}
+
+static int compareTimes(const void* a, const void* b) {
+  double da = *(const double*) a;
+  double db = *(const double*) b;
+  return (da > db) - (da < db);
+}
+
+static void printTimes(const char* name, double* times, int count) {
+  if (count < 1) {
+    printf("%s: unavailable\n", name);
+    return;
+  }
+
+  double sum = 0;
+
+  for (int i = 0; i < count; i++) {
+    sum += times[i];
+  }
+
+  qsort(times, count, sizeof(double), compareTimes);
+
+  printf("%s: mean %.3f ms, p50 %.3f ms, p95 %.3f ms, max %.3f ms\n",
+    name, sum / count, times[count / 2], times[(int) (count * 0.95)], times[count - 1]
+  );
+}
+
+// Frame rate, sim rate and input latency, comparable between thread modes
+static void printThroughput(double elapsed) {
+  frame_time_stats_t latency;
+  sim_stats_t sim;
+
+  cgaGetInputLatencyStats(&latency);
+  cgaGetSimStats(&sim);
+
+  if (latency.frames > 0) {
+    printf("Input latency: mean %.3f ms, p50 %.3f ms, p95 %.3f ms, max %.3f ms over %i inputs\n",
+      latency.mean * 1e3, latency.p50 * 1e3, latency.p95 * 1e3, latency.max * 1e3, latency.frames
+    );
+  } else {
+    printf("Input latency: unavailable\n");
+  }
+
+  printf("Throughput: %.1f frames/s, %.1f sim ticks/s, %llu of %llu snapshots skipped\n",
+    benchFrame / elapsed, sim.ticks / elapsed,
+    (unsigned long long) sim.skipped, (unsigned long long) sim.snapshots
+  );
+}
+
+int gameBenchmark(const game_bench_options_t* options) {
+  if (options->renderThread && options->goldenDir != null) {
+    logError("Golden frames need the single thread loop, the render thread skips snapshots");
+    return 1;
+  }
+
+  benchOptions = options;
+  benchCpuTimes = calloc(options->frames, sizeof(double));
+  benchGpuTimes = calloc(options->frames, sizeof(double));
+
+  if (benchCpuTimes == null || benchGpuTimes == null) {
+    logError("Failed to allocate benchmark buffers");
+    free(benchCpuTimes);
+    free(benchGpuTimes);
+    return 1;
+  }
+
+  cgaSetWindowMode(options->visible ? WINDOW_VISIBLE : WINDOW_OFFSCREEN);
+  cgaSetContextProfile(options->legacy ? CONTEXT_LEGACY : CONTEXT_AUTO);
+  cgaSetScreenSize(options->width, options->height);
+
+  if (!gameSetup(gameCreateSeeded(BENCH_SEED))) {
+    free(benchCpuTimes);
+    free(benchGpuTimes);
+    return 1;
+  }
+
+  // The overlay prints timings, frames have to be reproducible
+  debugInfoEnabled = false;
+
+  cgaSetScreenSize(options->width, options->height);
+  cgaSetSimCallback(onBenchSim);
+  cgaSetFrameCallback(onBenchFrame);
+  cgaSetFrameEndCallback(onBenchFrameEnd);
+  cgaSetFrameLimit(options->frames);
+  benchGpuTimer = cgaGpuTimerCreate();
+
+  if (options->renderThread) {
+    cgaSetThreadMode(THREAD_MODE_RENDER_THREAD);
+    cgaSetSimRate(BENCH_SIM_RATE);
+  }
+
+  if (options->solverDepth > 0) {
+    benchSolver = solverCreate(BENCH_SOLVER_TABLE_MB);
+
+    if (benchSolver == null) {
+      logWarn("Failed to create the solver, playing scripted moves");
+    }
+  }
+
+  startGame();
+
+  double start = cgaGetTime();
+  cgaLoop();
+  double elapsed = cgaGetTime() - start;
+
+  collectGpuTimes(true);
+
+  printf("%i frames at %ix%i in %.3f s, %s path, %s, %i scene rebuilds, score %i\n",
+    benchFrame, options->width, options->height, elapsed,
+    tiles != null ? "instanced" : "fixed function",
+    options->renderThread ? "render thread" : "single thread",
+    sceneRebuilds, gameGetScore(game)
+  );
+
+  printTimes("CPU", benchCpuTimes, benchFrame);
+  printTimes("GPU", benchGpuTimes, benchGpuSamples);
+  printThroughput(elapsed);
+
+  if (benchFrame > 1) {
+    int frames = benchFrame - 1;
+    printf("GL calls per frame: %.1f issued, %.1f elided, %.1f draws\n",
+      benchGlStats.issued / (double) frames, benchGlStats.elided / (double) frames,
+      benchGlStats.drawCalls / (double) frames
+    );
+  }
+
+  if (options->goldenDir != null) {
+    printf("Golden frames: %li mismatched\n", benchMismatches);
+  }
+
+  cgaGpuTimerFree(benchGpuTimer);
+  benchGpuTimer = null;
+  solverFree(benchSolver);
+  benchSolver = null;
+  gameTeardown();
+
+  free(benchCpuTimes);
+  free(benchGpuTimes);
+  benchCpuTimes = null;
+  benchGpuTimes = null;
+
+  return benchMismatches > 0 ? 1 : 0;
+}
@@ -1,6 +1,38 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include "cga_core.h"
+
+typedef struct GameBenchOptions {
+  int frames;
+  int width;
+  int height;
+  // A scripted move is played every moveInterval frames, the frames in
+  // between only blit the retained scene
+  int moveInterval;
+
+  // Every dumpInterval frames (0 never) the frame is written to dumpDir
+  // and/or compared with the dump of the same frame in goldenDir
+  int dumpInterval;
+  const char* dumpDir;
+  const char* goldenDir;
+
+  boolean legacy;
+  // Renders into a window instead of the EGL pbuffer
+  boolean visible;
+  // Draws on a render thread while the sim ticks at a fixed rate, see
+  // THREAD_MODE_RENDER_THREAD
+  boolean renderThread;
+  // Picks moves with an expectimax search this deep instead of the scripted
+  // corner strategy, 0 for the script. Stands in for heavy game logic.
+  int solverDepth;
+} game_bench_options_t;
+
 void gameMain();
 
+// Plays a fixed-seed game with scripted moves, then prints CPU and GPU
+// frame times, input latency and throughput. Returns 1 if a golden frame
+// didn't match or setup failed.
+int gameBenchmark(const game_bench_options_t* options);
+
 #endif // GAME_H
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "game_batch.h"
+#include <stdlib.h>
+
+#define STARTING_EXPONENT 1
+#define BATCH_GRAIN_SIZE 1024
+
+// Index of the n-th empty cell, n must be less than the empty count
+static int nthEmptyCell(board_t board, int n) {
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    if (((board >> (i * 4)) & 0xF) != 0) {
+      continue;
+    }
+
+    if (n-- == 0) {
+      return i;
+    }
+  }
+
+  return NO_SPAWN;
+}
+
+// Takes the lane's board and stream rather than the batch, so stepRange
+// keeps every board access behind its restrict pointer
+static int spawnInLane(board_t* board, random_t* rng) {
+  int empty = boardCountEmpty(*board);
+
+  if (empty == 0) {
+    return NO_SPAWN;
+  }
+
+  int n = (int) cgaRandomBounded(rng, (uint32_t) empty);
+  int cell = nthEmptyCell(*board, n);
+
+  *board = boardSetExponent(*board, cell, STARTING_EXPONENT);
+  return cell;
+}
+
+game_batch gameBatchCreate(int count, uint64_t seed) {
+  if (count < 1) {
+    return null;
+  }
+
+  boardInitTables();
+
+  game_batch batch = malloc(sizeof(game_batch_t));
+
+  if (batch == null) {
+    return null;
+  }
+
+  batch->count = count;
+  batch->boards = malloc(sizeof(board_t) * count);
+  batch->scores = malloc(sizeof(int32_t) * count);
+  batch->scoreDeltas = malloc(sizeof(int32_t) * count);
+  batch->spawnedCells = malloc(sizeof(int8_t) * count);
+  batch->lost = malloc(sizeof(uint8_t) * count);
+  batch->rngs = malloc(sizeof(random_t) * count);
+
+  if (batch->boards == null
+    || batch->scores == null
+    || batch->scoreDeltas == null
+    || batch->spawnedCells == null
+    || batch->lost == null
+    || batch->rngs == null
+  ) {
+    gameBatchFree(batch);
+    return null;
+  }
+
+  // One jump-ahead stream per lane so lanes never share a sequence
+  random_t base;
+  cgaRandomSeed(&base, seed);
+  cgaRandomStreams(&base, batch->rngs, count);
+
+  gameBatchReset(batch);
+  return batch;
+}
+
+void gameBatchFree(game_batch batch) {
+  if (batch == null) {
+    return;
+  }
+
+  free(batch->boards);
+  free(batch->scores);
+  free(batch->scoreDeltas);
+  free(batch->spawnedCells);
+  free(batch->lost);
+  free(batch->rngs);
+  free(batch);
+}
+
+void gameBatchResetGame(game_batch batch, int index) {
+  batch->boards[index] = 0;
+  batch->scores[index] = 0;
+  batch->scoreDeltas[index] = 0;
+  batch->lost[index] = false;
+
+  spawnInLane(&batch->boards[index], &batch->rngs[index]);
+  batch->spawnedCells[index] = (int8_t) spawnInLane(&batch->boards[index], &batch->rngs[index]);
+}
+
+void gameBatchReset(game_batch batch) {
+  for (int i = 0; i < batch->count; i++) {
+    gameBatchResetGame(batch, i);
+  }
+}
+
+typedef struct {
+  game_batch batch;
+  const uint8_t* moves;
+  atomic_int alive;
+} batch_step_t;
+
+static void stepRange(int start, int end, void* arg) {
+  batch_step_t* step = arg;
+  game_batch batch = step->batch;
+  const uint8_t* moves = step->moves;
+
+  board_t* restrict boards = batch->boards;
+  int32_t* restrict scores = batch->scores;
+  int32_t* restrict deltas = batch->scoreDeltas;
+  int8_t* restrict spawned = batch->spawnedCells;
+  uint8_t* restrict lost = batch->lost;
+
+  // Pass 1: table moves for every live lane
+  for (int i = start; i < end; i++) {
+    int delta = 0;
+    board_t before = boards[i];
+    board_t after = lost[i] ? before : boardShift(before, (shift_direction_t) (moves[i] & 3), &delta);
+
+    boards[i] = after;
+    deltas[i] = delta;
+    scores[i] += delta;
+    spawned[i] = (int8_t) (after != before);
+  }
+
+  // Pass 2: spawn a tile in every lane that moved
+  for (int i = start; i < end; i++) {
+    if (spawned[i]) {
+      spawned[i] = (int8_t) spawnInLane(&boards[i], &batch->rngs[i]);
+    } else {
+      spawned[i] = NO_SPAWN;
+    }
+  }
+
+  // Pass 3: lost flags
+  int alive = 0;
+
+  for (int i = start; i < end; i++) {
+    if (!lost[i] && spawned[i] != NO_SPAWN && !boardCanMove(boards[i])) {
+      lost[i] = true;
+    }
+
+    alive += !lost[i];
+  }
+
+  atomic_fetch_add_explicit(&step->alive, alive, memory_order_relaxed);
+}
+
+int gameBatchStep(game_batch batch, const uint8_t* moves) {
+  batch_step_t step = {.batch = batch, .moves = moves, .alive = 0};
+
+  cgaParallelFor(batch->count, BATCH_GRAIN_SIZE, stepRange, &step);
+
+  return atomic_load(&step.alive);
+}
@@ -0,0 +1,47 @@
+#ifndef GAME_BATCH_H
+#define GAME_BATCH_H
+
+#include <stdint.h>
+#include "cga_core.h"
+#include "game_board.h"
+#include "cga_random.h"
+
+#define NO_SPAWN -1
+
+// N independent games stored as structure-of-arrays, every array has
+// `count` entries and lane i of each array belongs to game i.
+typedef struct GameBatch {
+  int count;
+
+  board_t* boards;
+  int32_t* scores;
+
+  // Results of the last gameBatchStep
+  int32_t* scoreDeltas;
+  int8_t* spawnedCells;
+  uint8_t* lost;
+
+  random_t* rngs;
+} game_batch_t;
+
+typedef game_batch_t* game_batch;
+
+// Lane i draws its spawns from stream i of a generator seeded with `seed`,
+// so a batch is reproducible from the seed and the move vectors
+game_batch gameBatchCreate(int count, uint64_t seed);
+
+void gameBatchFree(game_batch batch);
+
+// Resets every game in the batch to a fresh board with 2 starting tiles
+void gameBatchReset(game_batch batch);
+
+void gameBatchResetGame(game_batch batch, int index);
+
+// Applies moves[i] to game i for every game that isn't lost. Games where the
+// move changed nothing keep their board, get a score delta of 0 and
+// spawnedCells[i] = NO_SPAWN. Returns the number of games that are not lost
+// after the step. Lanes are split into chunks across the job system's
+// workers when it's running.
+int gameBatchStep(game_batch batch, const uint8_t* moves);
+
+#endif // GAME_BATCH_H
@@ -0,0 +1,211 @@
+#include "game_board.h"
+
+#define ROW_COUNT 65536
+#define ROW_MASK 0xFFFFULL
+#define CELL_MASK 0xFULL
+
+#define SHIFT_LOW 0
+#define SHIFT_HIGH 1
+
+// Indexed by a 16-bit row (4 cells along y for a fixed x), holds the row
+// after all tiles are slid towards the low or high end of it.
+static uint16_t shiftTable[2][ROW_COUNT] = {0};
+static uint32_t scoreTable[2][ROW_COUNT] = {0};
+static boolean tablesInitialized = false;
+
+static uint16_t reverseRow(uint16_t row) {
+  return (row >> 12) | ((row >> 4) & 0x00F0) | ((row << 4) & 0x0F00) | (row << 12);
+}
+
+static uint16_t slideRowLow(uint16_t row, uint32_t* score) {
+  int cells[BOARD_HEIGHT];
+  int result[BOARD_HEIGHT] = {0};
+
+  for (int i = 0; i < BOARD_HEIGHT; i++) {
+    cells[i] = (row >> (i * 4)) & CELL_MASK;
+  }
+
+  int out = 0;
+  int pending = 0;
+  *score = 0;
+
+  for (int i = 0; i < BOARD_HEIGHT; i++) {
+    int v = cells[i];
+
+    if (v == 0) {
+      continue;
+    }
+
+    if (pending != 0 && pending == v && v < MAX_EXPONENT) {
+      result[out - 1] = v + 1;
+      *score += 1u << (v + 1);
+      pending = 0;
+      continue;
+    }
+
+    result[out++] = v;
+    pending = v;
+  }
+
+  uint16_t packed = 0;
+
+  for (int i = 0; i < BOARD_HEIGHT; i++) {
+    packed |= (uint16_t) (result[i] << (i * 4));
+  }
+
+  return packed;
+}
+
+void boardInitTables() {
+  if (tablesInitialized) {
+    return;
+  }
+
+  for (uint32_t row = 0; row < ROW_COUNT; row++) {
+    uint32_t score = 0;
+    shiftTable[SHIFT_LOW][row] = slideRowLow((uint16_t) row, &score);
+    scoreTable[SHIFT_LOW][row] = score;
+
+    uint16_t reversed = reverseRow((uint16_t) row);
+    shiftTable[SHIFT_HIGH][row] = reverseRow(slideRowLow(reversed, &score));
+    scoreTable[SHIFT_HIGH][row] = score;
+  }
+
+  tablesInitialized = true;
+}
+
+board_t boardTranspose(board_t x) {
+  board_t a1 = x & 0xF0F00F0FF0F00F0FULL;
+  board_t a2 = x & 0x0000F0F00000F0F0ULL;
+  board_t a3 = x & 0x0F0F00000F0F0000ULL;
+  board_t a = a1 | (a2 << 12) | (a3 >> 12);
+
+  board_t b1 = a & 0xFF00FF0000FF00FFULL;
+  board_t b2 = a & 0x00FF00FF00000000ULL;
+  board_t b3 = a & 0x00000000FF00FF00ULL;
+
+  return b1 | (b2 >> 24) | (b3 << 24);
+}
+
+static board_t shiftRows(board_t board, int table, int* scoreDelta) {
+  board_t result = 0;
+  uint32_t score = 0;
+
+  for (int i = 0; i < BOARD_WIDTH; i++) {
+    uint16_t row = (uint16_t) ((board >> (i * 16)) & ROW_MASK);
+    result |= ((board_t) shiftTable[table][row]) << (i * 16);
+    score += scoreTable[table][row];
+  }
+
+  if (scoreDelta != null) {
+    *scoreDelta = (int) score;
+  }
+
+  return result;
+}
+
+board_t boardShift(board_t board, shift_direction_t dir, int* scoreDelta) {
+  // Rows in the packed board run along y, so up/down work on them directly
+  // and left/right go through a transpose first
+  switch (dir) {
+    case DIR_UP:
+      return shiftRows(board, SHIFT_LOW, scoreDelta);
+
+    case DIR_DOWN:
+      return shiftRows(board, SHIFT_HIGH, scoreDelta);
+
+    case DIR_RIGHT:
+      return boardTranspose(shiftRows(boardTranspose(board), SHIFT_LOW, scoreDelta));
+
+    case DIR_LEFT:
+      return boardTranspose(shiftRows(boardTranspose(board), SHIFT_HIGH, scoreDelta));
+
+    default:
+      if (scoreDelta != null) {
+        *scoreDelta = 0;
+      }
+
+      return board;
+  }
+}
+
+int boardGetExponent(board_t board, int index) {
+  return (int) ((board >> (index * 4)) & CELL_MASK);
+}
+
+board_t boardSetExponent(board_t board, int index, int exponent) {
+  int shift = index * 4;
+  board &= ~(CELL_MASK << shift);
+  board |= ((board_t) exponent & CELL_MASK) << shift;
+  return board;
+}
+
+int boardGetValue(board_t board, int index) {
+  int exponent = boardGetExponent(board, index);
+
+  if (exponent == 0) {
+    return NO_CELL_VALUE;
+  }
+
+  return 1 << exponent;
+}
+
+board_t boardSetValue(board_t board, int index, int value) {
+  int exponent = 0;
+
+  while (value > 1 && exponent < MAX_EXPONENT) {
+    value >>= 1;
+    exponent++;
+  }
+
+  return boardSetExponent(board, index, exponent);
+}
+
+int boardCountEmpty(board_t board) {
+  if (board == 0) {
+    return BOARD_SIZE;
+  }
+
+  // Fold every non-zero nibble into its lowest bit, then count the zeros
+  board |= (board >> 2) & 0x3333333333333333ULL;
+  board |= (board >> 1);
+  board = ~board & 0x1111111111111111ULL;
+
+  return (int) ((board * 0x1111111111111111ULL) >> 60);
+}
+
+static boolean rowsCanMerge(board_t board) {
+  for (int i = 0; i < BOARD_WIDTH; i++) {
+    uint16_t row = (uint16_t) ((board >> (i * 16)) & ROW_MASK);
+
+    if (shiftTable[SHIFT_LOW][row] != row) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+boolean boardCanMove(board_t board) {
+  if (boardCountEmpty(board) > 0) {
+    return true;
+  }
+
+  return rowsCanMerge(board) || rowsCanMerge(boardTranspose(board));
+}
+
+void boardToArray(board_t board, int values[BOARD_SIZE]) {
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    values[i] = boardGetValue(board, i);
+  }
+}
+
+board_t boardFromArray(const int values[BOARD_SIZE]) {
+  board_t board = 0;
+
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    board = boardSetValue(board, i, values[i]);
+  }
+
+  return board;
+}
@@ -0,0 +1,61 @@
+#ifndef GAME_BOARD_H
+#define GAME_BOARD_H
+
+#include <stdint.h>
+#include "cga_core.h"
+
+#define BOARD_WIDTH 4
+#define BOARD_HEIGHT 4
+#define BOARD_SIZE (BOARD_HEIGHT * BOARD_WIDTH)
+
+#define TO_INDEX(x, y) ((BOARD_WIDTH * x) + y)
+#define IN_BOUNDS(x, y) ((x >= 0 && x < BOARD_WIDTH) && (y >= 0 && y < BOARD_HEIGHT))
+
+#define NO_CELL_VALUE 0
+
+// Largest exponent a 4-bit cell can hold, 2^15 = 32768
+#define MAX_EXPONENT 15
+
+typedef enum {
+  DIR_UP,
+  DIR_DOWN,
+  DIR_LEFT,
+  DIR_RIGHT
+} shift_direction_t;
+
+#define DIRECTION_COUNT 4
+
+// 4x4 board packed into a single 64-bit word, one 4-bit exponent per cell.
+// Cell TO_INDEX(x, y) lives in bits [index * 4, index * 4 + 4), an exponent
+// of 0 means the cell is empty and e > 0 means the cell holds 2^e.
+typedef uint64_t board_t;
+
+// Builds the per-row move tables, must be called before boardShift.
+// Calling it more than once is a no-op.
+void boardInitTables();
+
+// Shifts the whole board in a direction, merging equal neighbours.
+// The score gained from merges is written to scoreDelta if it's not null.
+// Nothing moved if the returned board equals the input.
+board_t boardShift(board_t board, shift_direction_t dir, int* scoreDelta);
+
+board_t boardTranspose(board_t board);
+
+int boardGetExponent(board_t board, int index);
+
+board_t boardSetExponent(board_t board, int index, int exponent);
+
+int boardGetValue(board_t board, int index);
+
+board_t boardSetValue(board_t board, int index, int value);
+
+int boardCountEmpty(board_t board);
+
+// True if at least one direction would move a tile
+boolean boardCanMove(board_t board);
+
+void boardToArray(board_t board, int values[BOARD_SIZE]);
+
+board_t boardFromArray(const int values[BOARD_SIZE]);
+
+#endif // GAME_BOARD_H
@@ -0,0 +1,358 @@
+#include "game_replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#define MOVES_PER_BYTE 4
+#define INITIAL_MOVE_BYTES 1024
+#define INITIAL_CHECKPOINTS 16
+
+static uint64_t moveBytes(uint64_t moveCount) {
+  return (moveCount + MOVES_PER_BYTE - 1) / MOVES_PER_BYTE;
+}
+
+static void captureCheckpoint(replay_checkpoint_t* cp, game_context game) {
+  cp->turn = (uint64_t) game->moveCount;
+  cp->board = game->board;
+  cp->score = (uint64_t) game->score;
+
+  for (int i = 0; i < 4; i++) {
+    cp->rng[i] = game->rng.s[i];
+  }
+}
+
+static void restoreCheckpoint(const replay_checkpoint_t* cp, game_context game, uint64_t seed) {
+  game->board = cp->board;
+  game->score = (int) cp->score;
+  game->moveCount = (int) cp->turn;
+  game->seed = seed;
+  game->lost = !boardCanMove(cp->board);
+
+  for (int i = 0; i < 4; i++) {
+    game->rng.s[i] = cp->rng[i];
+  }
+}
+
+static boolean pushCheckpoint(replay_writer writer, game_context game) {
+  if (writer->checkpointCount == writer->checkpointCapacity) {
+    uint32_t ncap = writer->checkpointCapacity * 2;
+    replay_checkpoint_t* nptr = realloc(writer->checkpoints, sizeof(replay_checkpoint_t) * ncap);
+
+    if (nptr == null) {
+      return false;
+    }
+
+    writer->checkpoints = nptr;
+    writer->checkpointCapacity = ncap;
+  }
+
+  captureCheckpoint(&writer->checkpoints[writer->checkpointCount++], game);
+  return true;
+}
+
+replay_writer replayWriterCreate(uint32_t checkpointInterval) {
+  if (checkpointInterval == 0) {
+    checkpointInterval = REPLAY_DEFAULT_CHECKPOINT_INTERVAL;
+  }
+
+  replay_writer writer = malloc(sizeof(replay_writer_t));
+
+  if (writer == null) {
+    return null;
+  }
+
+  writer->seed = 0;
+  writer->moveCount = 0;
+  writer->checkpointInterval = checkpointInterval;
+  writer->moves = calloc(INITIAL_MOVE_BYTES, 1);
+  writer->moveCapacity = INITIAL_MOVE_BYTES * MOVES_PER_BYTE;
+  writer->checkpoints = malloc(sizeof(replay_checkpoint_t) * INITIAL_CHECKPOINTS);
+  writer->checkpointCount = 0;
+  writer->checkpointCapacity = INITIAL_CHECKPOINTS;
+  writer->failed = false;
+
+  if (writer->moves == null || writer->checkpoints == null) {
+    replayWriterFree(writer);
+    return null;
+  }
+
+  return writer;
+}
+
+void replayWriterFree(replay_writer writer) {
+  if (writer == null) {
+    return;
+  }
+
+  free(writer->moves);
+  free(writer->checkpoints);
+  free(writer);
+}
+
+void replayWriterBegin(replay_writer writer, game_context game) {
+  writer->seed = game->seed;
+  writer->moveCount = 0;
+  writer->checkpointCount = 0;
+
+  memset(writer->moves, 0, moveBytes(writer->moveCapacity));
+  writer->failed = !pushCheckpoint(writer, game);
+}
+
+boolean replayWriterRecord(replay_writer writer, game_context game, shift_direction_t dir) {
+  if (writer->failed) {
+    return false;
+  }
+
+  if (writer->moveCount == writer->moveCapacity) {
+    uint64_t ncap = writer->moveCapacity * 2;
+    uint8_t* nptr = realloc(writer->moves, moveBytes(ncap));
+
+    if (nptr == null) {
+      writer->failed = true;
+      return false;
+    }
+
+    memset(nptr + moveBytes(writer->moveCapacity), 0, moveBytes(ncap) - moveBytes(writer->moveCapacity));
+
+    writer->moves = nptr;
+    writer->moveCapacity = ncap;
+  }
+
+  uint64_t turn = writer->moveCount++;
+  writer->moves[turn / MOVES_PER_BYTE] |= (uint8_t) ((dir & 3) << ((turn % MOVES_PER_BYTE) * 2));
+
+  if (writer->moveCount % writer->checkpointInterval == 0 && !pushCheckpoint(writer, game)) {
+    writer->failed = true;
+    return false;
+  }
+
+  return true;
+}
+
+boolean replayWriterSave(replay_writer writer, const char* path) {
+  if (writer->failed) {
+    return false;
+  }
+
+  FILE* file = fopen(path, "wb");
+
+  if (file == null) {
+    return false;
+  }
+
+  uint64_t bytes = moveBytes(writer->moveCount);
+
+  replay_header_t header = {
+    .magic = REPLAY_MAGIC,
+    .version = REPLAY_VERSION,
+    .seed = writer->seed,
+    .moveCount = writer->moveCount,
+    .checkpointInterval = writer->checkpointInterval,
+    .checkpointCount = writer->checkpointCount,
+    .checkpointOffset = sizeof(replay_header_t) + bytes
+  };
+
+  // Checkpoints are read in place from the mapping, keep them 8 byte aligned
+  uint64_t padding = (8 - (header.checkpointOffset % 8)) % 8;
+  header.checkpointOffset += padding;
+
+  const uint8_t zeros[8] = {0};
+
+  boolean ok = fwrite(&header, sizeof(header), 1, file) == 1
+    && fwrite(writer->moves, 1, bytes, file) == bytes
+    && fwrite(zeros, 1, padding, file) == padding
+    && fwrite(writer->checkpoints, sizeof(replay_checkpoint_t), writer->checkpointCount, file) == writer->checkpointCount;
+
+  fclose(file);
+  return ok;
+}
+
+static boolean mapFile(replay_reader reader, const char* path) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER size;
+
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+  if (mapping == NULL) {
+    CloseHandle(file);
+    return false;
+  }
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+  if (view == NULL) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  reader->data = view;
+  reader->size = (uint64_t) size.QuadPart;
+  reader->fileHandle = file;
+  reader->mappingHandle = mapping;
+  return true;
+#else
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  void* view = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (view == MAP_FAILED) {
+    return false;
+  }
+
+  reader->data = view;
+  reader->size = (uint64_t) st.st_size;
+  reader->fileHandle = null;
+  reader->mappingHandle = null;
+  return true;
+#endif
+}
+
+static void unmapFile(replay_reader reader) {
+  if (reader->data == null) {
+    return;
+  }
+
+#ifdef _WIN32
+  UnmapViewOfFile(reader->data);
+  CloseHandle(reader->mappingHandle);
+  CloseHandle(reader->fileHandle);
+#else
+  munmap((void*) reader->data, reader->size);
+#endif
+
+  reader->data = null;
+}
+
+static boolean validate(replay_reader reader) {
+  if (reader->size < sizeof(replay_header_t)) {
+    return false;
+  }
+
+  const replay_header_t* header = (const replay_header_t*) reader->data;
+
+  if (header->magic != REPLAY_MAGIC || header->version != REPLAY_VERSION) {
+    return false;
+  }
+
+  if (header->checkpointInterval == 0 || header->checkpointCount == 0) {
+    return false;
+  }
+
+  uint64_t movesEnd = sizeof(replay_header_t) + moveBytes(header->moveCount);
+  uint64_t checkpointBytes = (uint64_t) header->checkpointCount * sizeof(replay_checkpoint_t);
+
+  if (header->checkpointOffset < movesEnd || header->checkpointOffset % 8 != 0) {
+    return false;
+  }
+
+  return header->checkpointOffset + checkpointBytes <= reader->size;
+}
+
+replay_reader replayOpen(const char* path) {
+  replay_reader reader = calloc(1, sizeof(replay_reader_t));
+
+  if (reader == null) {
+    return null;
+  }
+
+  if (!mapFile(reader, path)) {
+    free(reader);
+    return null;
+  }
+
+  if (!validate(reader)) {
+    replayClose(reader);
+    return null;
+  }
+
+  reader->header = (const replay_header_t*) reader->data;
+  reader->moves = reader->data + sizeof(replay_header_t);
+  reader->checkpoints = (const replay_checkpoint_t*) (reader->data + reader->header->checkpointOffset);
+
+  return reader;
+}
+
+void replayClose(replay_reader reader) {
+  if (reader == null) {
+    return;
+  }
+
+  unmapFile(reader);
+  free(reader);
+}
+
+uint64_t replayGetSeed(replay_reader reader) {
+  return reader->header->seed;
+}
+
+uint64_t replayGetMoveCount(replay_reader reader) {
+  return reader->header->moveCount;
+}
+
+shift_direction_t replayGetMove(replay_reader reader, uint64_t turn) {
+  uint8_t packed = reader->moves[turn / MOVES_PER_BYTE];
+  return (shift_direction_t) ((packed >> ((turn % MOVES_PER_BYTE) * 2)) & 3);
+}
+
+boolean replaySeek(replay_reader reader, game_context game, uint64_t turn) {
+  const replay_header_t* header = reader->header;
+
+  if (turn > header->moveCount) {
+    return false;
+  }
+
+  uint64_t index = turn / header->checkpointInterval;
+
+  if (index >= header->checkpointCount) {
+    index = header->checkpointCount - 1;
+  }
+
+  const replay_checkpoint_t* cp = &reader->checkpoints[index];
+
+  if (cp->turn > turn) {
+    return false;
+  }
+
+  restoreCheckpoint(cp, game, header->seed);
+
+  for (uint64_t t = cp->turn; t < turn; t++) {
+    if (!gameMove(game, replayGetMove(reader, t))) {
+      return false;
+    }
+  }
+
+  return true;
+}
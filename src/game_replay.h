@@ -0,0 +1,103 @@
+#ifndef GAME_REPLAY_H
+#define GAME_REPLAY_H
+
+#include <stdint.h>
+#include "cga_core.h"
+#include "game_rules.h"
+
+// Replay file layout, all fields little-endian:
+//
+//   replay_header_t
+//   moves        2 bits per move, 4 moves per byte, first move in the low bits
+//   checkpoints  replay_checkpoint_t[checkpointCount]
+//
+// Only moves that changed the board are recorded, so turn N is the state
+// after gameGetMoveCount() == N. Spawns aren't stored, they're reproduced
+// from the seed.
+
+#define REPLAY_MAGIC 0x50523243 // "C2RP"
+#define REPLAY_VERSION 1
+#define REPLAY_DEFAULT_CHECKPOINT_INTERVAL 4096
+
+typedef struct ReplayHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t seed;
+  uint64_t moveCount;
+  uint32_t checkpointInterval;
+  uint32_t checkpointCount;
+  uint64_t checkpointOffset;
+} replay_header_t;
+
+// Full game state after `turn` moves
+typedef struct ReplayCheckpoint {
+  uint64_t turn;
+  uint64_t board;
+  uint64_t score;
+  uint64_t rng[4];
+} replay_checkpoint_t;
+
+typedef struct ReplayWriter {
+  uint64_t seed;
+  uint64_t moveCount;
+  uint32_t checkpointInterval;
+
+  uint8_t* moves;
+  uint64_t moveCapacity;
+
+  replay_checkpoint_t* checkpoints;
+  uint32_t checkpointCount;
+  uint32_t checkpointCapacity;
+
+  // Set when a move or checkpoint couldn't be stored. Later moves would
+  // replay against the wrong spawns, so the recording can't be saved.
+  boolean failed;
+} replay_writer_t;
+
+typedef replay_writer_t* replay_writer;
+
+typedef struct ReplayReader {
+  const uint8_t* data;
+  uint64_t size;
+
+  const replay_header_t* header;
+  const uint8_t* moves;
+  const replay_checkpoint_t* checkpoints;
+
+  void* fileHandle;
+  void* mappingHandle;
+} replay_reader_t;
+
+typedef replay_reader_t* replay_reader;
+
+replay_writer replayWriterCreate(uint32_t checkpointInterval);
+
+void replayWriterFree(replay_writer writer);
+
+// Starts recording a freshly reset game, drops any moves recorded before
+void replayWriterBegin(replay_writer writer, game_context game);
+
+// Records a move, call after gameMove returned true. Returns false and
+// sets failed if it couldn't be stored, or if an earlier one wasn't.
+boolean replayWriterRecord(replay_writer writer, game_context game, shift_direction_t dir);
+
+// Returns false without writing anything if the recording failed
+boolean replayWriterSave(replay_writer writer, const char* path);
+
+// Memory maps a replay file, returns null if it can't be opened or is invalid
+replay_reader replayOpen(const char* path);
+
+void replayClose(replay_reader reader);
+
+uint64_t replayGetSeed(replay_reader reader);
+
+uint64_t replayGetMoveCount(replay_reader reader);
+
+shift_direction_t replayGetMove(replay_reader reader, uint64_t turn);
+
+// Puts the game into the state after `turn` moves, starting from the closest
+// checkpoint at or before it. Returns false if the turn is out of range or
+// a recorded move no longer changes the board.
+boolean replaySeek(replay_reader reader, game_context game, uint64_t turn);
+
+#endif // GAME_REPLAY_H
@@ -0,0 +1,134 @@
+#include "game_rules.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define OUT_OF_BOUNDS -1
+
+game_context gameCreate() {
+  uint64_t seed = (uint64_t) time(null);
+  seed ^= (uint64_t) (uintptr_t) &seed;
+
+  return gameCreateSeeded(seed);
+}
+
+game_context gameCreateSeeded(uint64_t seed) {
+  boardInitTables();
+
+  game_context game = malloc(sizeof(game_context_t));
+
+  if (game == null) {
+    return null;
+  }
+
+  game->board = 0;
+  game->score = 0;
+  game->moveCount = 0;
+  game->lost = false;
+  game->seed = seed;
+
+  cgaRandomSeed(&game->seedSource, seed);
+  cgaRandomSeed(&game->rng, seed);
+
+  return game;
+}
+
+void gameFree(game_context game) {
+  if (game == null) {
+    return;
+  }
+
+  free(game);
+}
+
+void gameReset(game_context game) {
+  gameResetSeeded(game, cgaRandomNext(&game->seedSource));
+}
+
+void gameResetSeeded(game_context game, uint64_t seed) {
+  game->seed = seed;
+  cgaRandomSeed(&game->rng, seed);
+
+  game->board = 0;
+  game->score = 0;
+  game->moveCount = 0;
+  game->lost = false;
+
+  gameSpawnTile(game);
+  gameSpawnTile(game);
+}
+
+boolean gameSpawnTile(game_context game) {
+  int freeSlots[BOARD_SIZE];
+  int freeSlotCount = 0;
+
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    if (boardGetExponent(game->board, i) != 0) {
+      continue;
+    }
+
+    freeSlots[freeSlotCount++] = i;
+  }
+
+  if (freeSlotCount == 0) {
+    return false;
+  }
+
+  int index = (int) cgaRandomBounded(&game->rng, (uint32_t) freeSlotCount);
+  int boardSlot = freeSlots[index];
+
+  game->board = boardSetValue(game->board, boardSlot, STARTING_VALUE);
+  return true;
+}
+
+boolean gameMove(game_context game, shift_direction_t dir) {
+  if (game->lost) {
+    return false;
+  }
+
+  int scoreDelta = 0;
+  board_t shifted = boardShift(game->board, dir, &scoreDelta);
+
+  if (shifted == game->board) {
+    return false;
+  }
+
+  game->board = shifted;
+  game->score += scoreDelta;
+  game->moveCount++;
+
+  gameSpawnTile(game);
+
+  if (!boardCanMove(game->board)) {
+    game->lost = true;
+  }
+
+  return true;
+}
+
+int gameGetCell(game_context game, int x, int y) {
+  if (!IN_BOUNDS(x, y)) {
+    return OUT_OF_BOUNDS;
+  }
+
+  return boardGetValue(game->board, TO_INDEX(x, y));
+}
+
+board_t gameGetBoard(game_context game) {
+  return game->board;
+}
+
+int gameGetScore(game_context game) {
+  return game->score;
+}
+
+int gameGetMoveCount(game_context game) {
+  return game->moveCount;
+}
+
+uint64_t gameGetSeed(game_context game) {
+  return game->seed;
+}
+
+boolean gameIsLost(game_context game) {
+  return game->lost;
+}
@@ -0,0 +1,64 @@
+#ifndef GAME_RULES_H
+#define GAME_RULES_H
+
+#include "cga_core.h"
+#include "game_board.h"
+#include "cga_random.h"
+
+// Value of every newly spawned tile
+#define STARTING_VALUE 2
+
+typedef struct GameContext {
+  board_t board;
+  int score;
+  int moveCount;
+  boolean lost;
+
+  // Seed the current game was started from, replaying the same moves
+  // from gameResetSeeded(seed) gives the same game
+  uint64_t seed;
+  random_t rng;
+
+  // Picks the seed of the next game in gameReset
+  random_t seedSource;
+} game_context_t;
+
+typedef game_context_t* game_context;
+
+// Creates a game whose seeds are derived from the current time
+game_context gameCreate();
+
+// Creates a game whose seeds are derived from `seed`, the whole sequence of
+// games it plays through gameReset is then reproducible
+game_context gameCreateSeeded(uint64_t seed);
+
+void gameFree(game_context game);
+
+// Clears the board and score, then spawns the 2 starting tiles. The new
+// game's seed is the next value of the context's seed source.
+void gameReset(game_context game);
+
+// Like gameReset, but starts the game from an explicit seed
+void gameResetSeeded(game_context game, uint64_t seed);
+
+// Shifts the board in a direction. If anything moved, a new tile is spawned
+// and the lost state is updated. Returns false if the move changed nothing
+// or the game is already lost.
+boolean gameMove(game_context game, shift_direction_t dir);
+
+// Places a STARTING_VALUE tile in a random free cell, false if the board is full
+boolean gameSpawnTile(game_context game);
+
+int gameGetCell(game_context game, int x, int y);
+
+board_t gameGetBoard(game_context game);
+
+int gameGetScore(game_context game);
+
+int gameGetMoveCount(game_context game);
+
+uint64_t gameGetSeed(game_context game);
+
+boolean gameIsLost(game_context game);
+
+#endif // GAME_RULES_H
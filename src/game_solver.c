@@ -0,0 +1,438 @@
+#include "game_solver.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE 64
+#define ROW_COUNT 65536
+#define STARTING_EXPONENT 1
+
+// Far below any heuristic value, which goes negative on rough boards
+#define LOST_VALUE -1e9f
+
+#define EMPTY_WEIGHT 20.0f
+#define MERGE_WEIGHT 30.0f
+#define MONOTONIC_WEIGHT 0.05f
+
+#define DATA_VALUE_MASK 0xFFFFFFFFULL
+#define DATA_DEPTH_SHIFT 32
+
+typedef struct {
+  solver s;
+  uint64_t nodes;
+  uint64_t ttLookups;
+  uint64_t ttHits;
+} search_t;
+
+static float heuristicTable[ROW_COUNT] = {0};
+static boolean heuristicInitialized = false;
+
+static double pow4(int rank) {
+  double r = rank;
+  return r * r * r * r;
+}
+
+static void initHeuristics() {
+  if (heuristicInitialized) {
+    return;
+  }
+
+  for (uint32_t row = 0; row < ROW_COUNT; row++) {
+    int rank[BOARD_HEIGHT];
+    int empty = 0;
+    int merges = 0;
+    int prev = 0;
+    double monoLow = 0;
+    double monoHigh = 0;
+
+    for (int i = 0; i < BOARD_HEIGHT; i++) {
+      rank[i] = (row >> (i * 4)) & 0xF;
+
+      if (rank[i] == 0) {
+        empty++;
+        continue;
+      }
+
+      if (prev == rank[i]) {
+        merges++;
+        prev = 0;
+      } else {
+        prev = rank[i];
+      }
+    }
+
+    for (int i = 1; i < BOARD_HEIGHT; i++) {
+      double a = pow4(rank[i - 1]);
+      double b = pow4(rank[i]);
+
+      if (rank[i - 1] > rank[i]) {
+        monoLow += a - b;
+      } else {
+        monoHigh += b - a;
+      }
+    }
+
+    double mono = monoLow < monoHigh ? monoLow : monoHigh;
+
+    heuristicTable[row] = EMPTY_WEIGHT * empty
+      + MERGE_WEIGHT * merges
+      - MONOTONIC_WEIGHT * (float) mono;
+  }
+
+  heuristicInitialized = true;
+}
+
+static float sumRows(board_t board) {
+  float sum = 0;
+
+  for (int i = 0; i < BOARD_WIDTH; i++) {
+    sum += heuristicTable[(board >> (i * 16)) & 0xFFFF];
+  }
+
+  return sum;
+}
+
+static float evaluate(board_t board) {
+  return sumRows(board) + sumRows(boardTranspose(board));
+}
+
+// Reverses cell order inside every 16-bit row (mirrors y)
+static board_t mirrorRows(board_t b) {
+  return ((b >> 12) & 0x000F000F000F000FULL)
+    | ((b >> 4) & 0x00F000F000F000F0ULL)
+    | ((b << 4) & 0x0F000F000F000F00ULL)
+    | ((b << 12) & 0xF000F000F000F000ULL);
+}
+
+// Reverses the order of the 16-bit rows (mirrors x)
+static board_t mirrorColumns(board_t b) {
+  return (b >> 48)
+    | ((b >> 16) & 0x00000000FFFF0000ULL)
+    | ((b << 16) & 0x0000FFFF00000000ULL)
+    | (b << 48);
+}
+
+#define KEEP_MIN(best, candidate) if (candidate < best) best = candidate
+
+board_t solverCanonicalBoard(board_t board) {
+  board_t best = board;
+  board_t r = mirrorRows(board);
+  board_t c = mirrorColumns(board);
+  board_t rc = mirrorColumns(r);
+
+  KEEP_MIN(best, r);
+  KEEP_MIN(best, c);
+  KEEP_MIN(best, rc);
+
+  board_t t = boardTranspose(board);
+  board_t tr = mirrorRows(t);
+  board_t tc = mirrorColumns(t);
+  board_t trc = mirrorColumns(tr);
+
+  KEEP_MIN(best, t);
+  KEEP_MIN(best, tr);
+  KEEP_MIN(best, tc);
+  KEEP_MIN(best, trc);
+
+  return best;
+}
+
+static uint64_t hashKey(board_t key) {
+  key ^= key >> 33;
+  key *= 0xFF51AFD7ED558CCDULL;
+  key ^= key >> 33;
+  key *= 0xC4CEB9FE1A85EC53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+static uint64_t packData(float value, int depth) {
+  uint32_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  return ((uint64_t) depth << DATA_DEPTH_SHIFT) | bits;
+}
+
+static float unpackValue(uint64_t data) {
+  uint32_t bits = (uint32_t) (data & DATA_VALUE_MASK);
+  float value = 0;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static int unpackDepth(uint64_t data) {
+  return (int) (data >> DATA_DEPTH_SHIFT);
+}
+
+static boolean tableLookup(search_t* search, board_t key, int depth, float* value) {
+  solver_bucket_t* bucket = &search->s->buckets[hashKey(key) & search->s->bucketMask];
+  search->ttLookups++;
+
+  for (int i = 0; i < SOLVER_BUCKET_ENTRIES; i++) {
+    solver_entry_t* entry = &bucket->entries[i];
+
+    uint64_t data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+    uint64_t check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+
+    if ((check ^ data) != key || data == 0) {
+      continue;
+    }
+
+    if (unpackDepth(data) < depth) {
+      return false;
+    }
+
+    search->ttHits++;
+    *value = unpackValue(data);
+    return true;
+  }
+
+  return false;
+}
+
+static void tableStore(search_t* search, board_t key, int depth, float value) {
+  solver_bucket_t* bucket = &search->s->buckets[hashKey(key) & search->s->bucketMask];
+  solver_entry_t* victim = &bucket->entries[0];
+  int victimDepth = 0x7FFFFFFF;
+
+  for (int i = 0; i < SOLVER_BUCKET_ENTRIES; i++) {
+    solver_entry_t* entry = &bucket->entries[i];
+
+    uint64_t data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+    uint64_t check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+
+    // Same position or empty slot, reuse it
+    if (data == 0 || (check ^ data) == key) {
+      victim = entry;
+      break;
+    }
+
+    int entryDepth = unpackDepth(data);
+
+    if (entryDepth < victimDepth) {
+      victim = entry;
+      victimDepth = entryDepth;
+    }
+  }
+
+  uint64_t data = packData(value, depth);
+
+  atomic_store_explicit(&victim->check, key ^ data, memory_order_relaxed);
+  atomic_store_explicit(&victim->data, data, memory_order_relaxed);
+}
+
+static float chanceNode(search_t* search, board_t board, int depth);
+
+static float maxNode(search_t* search, board_t board, int depth) {
+  search->nodes++;
+
+  float best = LOST_VALUE;
+  boolean anyMoved = false;
+
+  for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+    int delta = 0;
+    board_t shifted = boardShift(board, (shift_direction_t) dir, &delta);
+
+    if (shifted == board) {
+      continue;
+    }
+
+    float value = delta + chanceNode(search, shifted, depth - 1);
+
+    if (!anyMoved || value > best) {
+      best = value;
+      anyMoved = true;
+    }
+  }
+
+  return best;
+}
+
+// Board after a move, before the new tile spawns
+static float chanceNode(search_t* search, board_t board, int depth) {
+  search->nodes++;
+
+  if (depth <= 0) {
+    return evaluate(board);
+  }
+
+  board_t key = solverCanonicalBoard(board);
+  float cached = 0;
+
+  if (tableLookup(search, key, depth, &cached)) {
+    return cached;
+  }
+
+  float sum = 0;
+  int empty = 0;
+
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    if (boardGetExponent(board, i) != 0) {
+      continue;
+    }
+
+    sum += maxNode(search, boardSetExponent(board, i, STARTING_EXPONENT), depth);
+    empty++;
+  }
+
+  float value = empty > 0 ? sum / empty : evaluate(board);
+
+  tableStore(search, key, depth, value);
+  return value;
+}
+
+solver solverCreate(int tableMb) {
+  if (tableMb < 1) {
+    tableMb = SOLVER_DEFAULT_TABLE_MB;
+  }
+
+  boardInitTables();
+  initHeuristics();
+
+  uint64_t bytes = (uint64_t) tableMb * 1024 * 1024;
+  uint64_t bucketCount = 1;
+
+  while (bucketCount * 2 * sizeof(solver_bucket_t) <= bytes) {
+    bucketCount *= 2;
+  }
+
+  solver s = malloc(sizeof(solver_t));
+
+  if (s == null) {
+    return null;
+  }
+
+  size_t tableSize = bucketCount * sizeof(solver_bucket_t);
+  s->allocation = malloc(tableSize + CACHE_LINE);
+
+  if (s->allocation == null) {
+    free(s);
+    return null;
+  }
+
+  uintptr_t aligned = ((uintptr_t) s->allocation + CACHE_LINE - 1) & ~((uintptr_t) CACHE_LINE - 1);
+
+  s->buckets = (solver_bucket_t*) aligned;
+  s->bucketMask = bucketCount - 1;
+
+  solverClearTable(s);
+  return s;
+}
+
+void solverFree(solver s) {
+  if (s == null) {
+    return;
+  }
+
+  free(s->allocation);
+  free(s);
+}
+
+void solverClearTable(solver s) {
+  memset(s->buckets, 0, (s->bucketMask + 1) * sizeof(solver_bucket_t));
+}
+
+// One root chance outcome: a move followed by a spawn in one cell. These are
+// the units handed to the job system.
+typedef struct {
+  search_t search;
+  board_t board;
+  int depth;
+  float value;
+} root_job_t;
+
+static void runRootJob(void* arg) {
+  root_job_t* job = arg;
+  job->value = maxNode(&job->search, job->board, job->depth);
+}
+
+int solverBestMove(solver s, board_t board, int depth, float* expectedScore, solver_stats_t* stats) {
+  if (depth < 1) {
+    depth = 1;
+  }
+
+  double start = cgaGetTime();
+
+  root_job_t jobs[DIRECTION_COUNT][BOARD_SIZE];
+  int jobCounts[DIRECTION_COUNT] = {0};
+  int deltas[DIRECTION_COUNT] = {0};
+  board_t shifted[DIRECTION_COUNT];
+  job_counter_t counter = {0};
+
+  search_t search = {.s = s};
+
+  for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+    shifted[dir] = boardShift(board, (shift_direction_t) dir, &deltas[dir]);
+
+    if (shifted[dir] == board || depth == 1) {
+      continue;
+    }
+
+    search.nodes++;
+
+    for (int i = 0; i < BOARD_SIZE; i++) {
+      if (boardGetExponent(shifted[dir], i) != 0) {
+        continue;
+      }
+
+      root_job_t* job = &jobs[dir][jobCounts[dir]++];
+      job->search = (search_t) {.s = s};
+      job->board = boardSetExponent(shifted[dir], i, STARTING_EXPONENT);
+      job->depth = depth - 1;
+      job->value = 0;
+
+      cgaJobSubmit(runRootJob, job, &counter);
+    }
+  }
+
+  cgaJobWait(&counter);
+
+  int bestMove = SOLVER_NO_MOVE;
+  float bestValue = LOST_VALUE;
+
+  for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+    if (shifted[dir] == board) {
+      continue;
+    }
+
+    float value = 0;
+
+    if (depth == 1) {
+      value = chanceNode(&search, shifted[dir], 0);
+    } else {
+      for (int j = 0; j < jobCounts[dir]; j++) {
+        root_job_t* job = &jobs[dir][j];
+
+        value += job->value;
+        search.nodes += job->search.nodes;
+        search.ttLookups += job->search.ttLookups;
+        search.ttHits += job->search.ttHits;
+      }
+
+      value /= jobCounts[dir];
+    }
+
+    value += deltas[dir];
+
+    if (bestMove == SOLVER_NO_MOVE || value > bestValue) {
+      bestValue = value;
+      bestMove = dir;
+    }
+  }
+
+  double elapsed = cgaGetTime() - start;
+
+  if (expectedScore != null) {
+    *expectedScore = bestValue;
+  }
+
+  if (stats != null) {
+    stats->nodes = search.nodes;
+    stats->ttLookups = search.ttLookups;
+    stats->ttHits = search.ttHits;
+    stats->elapsedSecs = elapsed;
+    stats->nodesPerSec = elapsed > 0 ? search.nodes / elapsed : 0;
+    stats->ttHitRate = search.ttLookups > 0 ? search.ttHits / (double) search.ttLookups : 0;
+  }
+
+  return bestMove;
+}
@@ -0,0 +1,64 @@
+#ifndef GAME_SOLVER_H
+#define GAME_SOLVER_H
+
+#include <stdint.h>
+#include "cga_core.h"
+#include "game_board.h"
+
+#define SOLVER_NO_MOVE -1
+#define SOLVER_DEFAULT_TABLE_MB 64
+
+typedef struct SolverStats {
+  uint64_t nodes;
+  uint64_t ttLookups;
+  uint64_t ttHits;
+  double elapsedSecs;
+  double nodesPerSec;
+  double ttHitRate;
+} solver_stats_t;
+
+// One transposition table entry, verified with the key ^ data trick so
+// concurrent readers and writers never need a lock. A torn entry simply
+// fails the check and reads as a miss.
+typedef struct SolverEntry {
+  _Atomic uint64_t check;
+  _Atomic uint64_t data;
+} solver_entry_t;
+
+#define SOLVER_BUCKET_ENTRIES 4
+
+// Exactly one 64 byte cache line
+typedef struct SolverBucket {
+  solver_entry_t entries[SOLVER_BUCKET_ENTRIES];
+} solver_bucket_t;
+
+typedef struct Solver {
+  solver_bucket_t* buckets;
+  uint64_t bucketMask;
+  void* allocation;
+} solver_t;
+
+typedef solver_t* solver;
+
+// Creates a solver with a transposition table of roughly tableMb megabytes,
+// rounded down to a power of 2 bucket count
+solver solverCreate(int tableMb);
+
+void solverFree(solver s);
+
+void solverClearTable(solver s);
+
+// Expectimax search over max nodes (the 4 shift directions) and chance nodes
+// (a STARTING_VALUE tile in every free cell), `depth` moves deep.
+// Returns the best shift_direction_t or SOLVER_NO_MOVE if nothing can move.
+// expectedScore receives the search value of the best move: the expected
+// score gained over the horizon plus the leaf evaluation.
+// stats and expectedScore may be null. Every (move, spawn) pair at the root
+// is submitted as a job, so the search spreads across the job system's
+// workers when it's running.
+int solverBestMove(solver s, board_t board, int depth, float* expectedScore, solver_stats_t* stats);
+
+// Smallest of the 8 rotations/reflections of the board
+board_t solverCanonicalBoard(board_t board);
+
+#endif // GAME_SOLVER_H
@@ -1,7 +1,7 @@
 #ifndef GLUTIL_H
 #define GLUTIL_H
 
-#include <gl/GL.h>
+#include <GL/glew.h>
 
 void drawQuad(float startX, float startY, float endX, float endY);
 
@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <signal.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "log.h"
 #include "cga_core.h"
@@ -8,12 +12,29 @@
 #define BUF_SIZE 250
 #define TIME_BUF 100
 
+#define LOG_BATCH_SIZE 64
+#define LOG_IDLE_WAIT_NS 100000000L
+#define LOG_FLUSH_SLEEP 0.0005
+#define CRASH_SPIN_ATTEMPTS 1000000
+
 typedef struct {
   char name[6];
 } level_info_t;
 
-static char msgBuf[BUF_SIZE] = {0};
-static char timeBuffer[TIME_BUF] = {0};
+// Slot of the async ring. sequence == position means free for the producer
+// claiming that position, position + 1 means written and ready to print.
+typedef struct {
+  atomic_size_t sequence;
+  log_level_t level;
+  time_t time;
+  char message[BUF_SIZE];
+} log_record_t;
+
+typedef struct {
+  time_t second;
+  char text[TIME_BUF];
+  boolean valid;
+} time_cache_t;
 
 static level_info_t levelInfoTable[4] = {
   {.name = " INFO"},
@@ -22,16 +43,214 @@ static level_info_t levelInfoTable[4] = {
   {.name = "ERROR"}
 };
 
-static boolean formatTime() {
-  time_t now = time(null);
-  int result = strftime(timeBuffer, TIME_BUF, "%H:%M:%S", localtime(&now));
-  return result > 0;
+static const int crashSignals[] = {SIGSEGV, SIGABRT, SIGFPE, SIGILL};
+
+#define CRASH_SIGNAL_COUNT ((int) (sizeof(crashSignals) / sizeof(crashSignals[0])))
+
+// Bounded multi-producer ring (Vyukov), drained by the writer thread
+static log_record_t* ring = null;
+static size_t ringMask = 0;
+static atomic_size_t ringTail = 0;
+static atomic_size_t ringHead = 0;
+
+static atomic_int asyncRunning = 0;
+// Threads inside cgaLog, the ring is only freed once they're out
+static atomic_int activeProducers = 0;
+static atomic_ullong droppedRecords = 0;
+static uint64_t reportedDrops = 0;
+// Held by whoever drains the ring, the writer or a crash handler
+static atomic_flag consumerBusy = ATOMIC_FLAG_INIT;
+
+static pthread_t writerThread;
+static pthread_mutex_t writerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writerCond = PTHREAD_COND_INITIALIZER;
+static atomic_int writerSleeping = 0;
+
+static boolean exitHookInstalled = false;
+static void (*previousHandlers[CRASH_SIGNAL_COUNT])(int);
+
+static _Thread_local time_cache_t timeCache = {0};
+
+// strftime only runs when the second changes
+static const char* formatTime(time_t now) {
+  if (timeCache.valid && timeCache.second == now) {
+    return timeCache.text;
+  }
+
+  struct tm local;
+
+#ifdef _WIN32
+  boolean converted = localtime_s(&local, &now) == 0;
+#else
+  boolean converted = localtime_r(&now, &local) != null;
+#endif
+
+  timeCache.valid = converted && strftime(timeCache.text, TIME_BUF, "%H:%M:%S", &local) > 0;
+  timeCache.second = now;
+
+  return timeCache.valid ? timeCache.text : null;
+}
+
+static void writeLine(log_level_t level, time_t now, const char* message) {
+  FILE* outstream = level == LL_ERROR ? stderr : stdout;
+  level_info_t inf = levelInfoTable[level];
+  const char* timeText = formatTime(now);
+
+  if (timeText != null) {
+    fprintf(outstream, "[%s %s] %s\n", timeText, inf.name, message);
+  } else {
+    fprintf(outstream, "[%s] %s\n", inf.name, message);
+  }
+}
+
+// Consumer side, only called while holding consumerBusy
+static int drainRecords(int maxRecords) {
+  int written = 0;
+
+  while (written < maxRecords) {
+    size_t head = atomic_load_explicit(&ringHead, memory_order_relaxed);
+    log_record_t* record = &ring[head & ringMask];
+    size_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+
+    if (sequence != head + 1) {
+      break;
+    }
+
+    writeLine(record->level, record->time, record->message);
+
+    atomic_store_explicit(&record->sequence, head + ringMask + 1, memory_order_release);
+    atomic_store_explicit(&ringHead, head + 1, memory_order_release);
+    written++;
+  }
+
+  uint64_t dropped = atomic_load(&droppedRecords);
+
+  if (dropped != reportedDrops) {
+    char message[BUF_SIZE];
+    snprintf(message, BUF_SIZE, "Log ring full, dropped %llu messages",
+      (unsigned long long) (dropped - reportedDrops)
+    );
+
+    writeLine(LL_WARN, time(null), message);
+    reportedDrops = dropped;
+    written++;
+  }
+
+  if (written > 0) {
+    fflush(stdout);
+    fflush(stderr);
+  }
+
+  return written;
+}
+
+static boolean ringEmpty() {
+  return atomic_load(&ringHead) == atomic_load(&ringTail);
+}
+
+static void* writerMain(void* arg) {
+  (void) arg;
+
+  while (atomic_load(&asyncRunning) || !ringEmpty()) {
+    int written = 0;
+
+    if (!atomic_flag_test_and_set(&consumerBusy)) {
+      written = drainRecords(LOG_BATCH_SIZE);
+      atomic_flag_clear(&consumerBusy);
+    }
+
+    if (written > 0) {
+      continue;
+    }
+
+    // Same handshake as the job system, producers only take the lock
+    // when the writer says it's asleep
+    pthread_mutex_lock(&writerLock);
+    atomic_store(&writerSleeping, 1);
+
+    if (ringEmpty() && atomic_load(&asyncRunning)) {
+      struct timespec deadline;
+      timespec_get(&deadline, TIME_UTC);
+      deadline.tv_nsec += LOG_IDLE_WAIT_NS;
+
+      if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+      }
+
+      pthread_cond_timedwait(&writerCond, &writerLock, &deadline);
+    }
+
+    atomic_store(&writerSleeping, 0);
+    pthread_mutex_unlock(&writerLock);
+  }
+
+  return null;
+}
+
+static void wakeWriter() {
+  if (!atomic_load(&writerSleeping)) {
+    return;
+  }
+
+  pthread_mutex_lock(&writerLock);
+  pthread_cond_signal(&writerCond);
+  pthread_mutex_unlock(&writerLock);
+}
+
+static boolean enqueue(log_level_t level, const char* message, va_list args) {
+  size_t position = atomic_load_explicit(&ringTail, memory_order_relaxed);
+  log_record_t* record;
+
+  for (;;) {
+    record = &ring[position & ringMask];
+    size_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t) sequence - (intptr_t) position;
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(
+        &ringTail, &position, position + 1, memory_order_relaxed, memory_order_relaxed
+      )) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The writer hasn't freed this slot from the previous lap
+      atomic_fetch_add(&droppedRecords, 1);
+      return false;
+    } else {
+      position = atomic_load_explicit(&ringTail, memory_order_relaxed);
+    }
+  }
+
+  if (vsnprintf(record->message, BUF_SIZE, message, args) < 0) {
+    record->message[0] = '\0';
+  }
+
+  record->level = level;
+  record->time = time(null);
+
+  atomic_store_explicit(&record->sequence, position + 1, memory_order_release);
+  wakeWriter();
+
+  return true;
 }
 
 void cgaLog(log_level_t level, char* message, ...) {
   va_list args;
   va_start(args, message);
-  
+
+  atomic_fetch_add(&activeProducers, 1);
+
+  if (atomic_load(&asyncRunning)) {
+    enqueue(level, message, args);
+    atomic_fetch_sub(&activeProducers, 1);
+    va_end(args);
+    return;
+  }
+
+  atomic_fetch_sub(&activeProducers, 1);
+
+  char msgBuf[BUF_SIZE];
   int printed = vsnprintf(msgBuf, BUF_SIZE, message, args);
   va_end(args);
 
@@ -39,19 +258,120 @@ void cgaLog(log_level_t level, char* message, ...) {
     return;
   }
 
-  void* outstream;
+  writeLine(level, time(null), msgBuf);
+}
 
-  if (level == LL_ERROR) {
-    outstream = stderr;
-  } else {
-    outstream = stdout;
+// Best effort, the crashing thread may be the one holding consumerBusy or
+// a producer in the middle of a record
+static void onCrash(int sig) {
+  if (ring != null) {
+    for (int i = 0; i < CRASH_SPIN_ATTEMPTS; i++) {
+      if (!atomic_flag_test_and_set(&consumerBusy)) {
+        drainRecords(INT32_MAX);
+        atomic_flag_clear(&consumerBusy);
+        break;
+      }
+    }
   }
 
-  level_info_t inf = levelInfoTable[level];
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
 
-  if (formatTime()) {
-    fprintf(outstream, "[%s %s] %s\n", timeBuffer, inf.name, msgBuf);
-  } else {
-    fprintf(outstream, "[%s] %s\n", inf.name, msgBuf);
+static void onExit() {
+  cgaLogStopAsync();
+}
+
+boolean cgaLogStartAsync(int capacity) {
+  if (atomic_load(&asyncRunning)) {
+    return true;
+  }
+
+  size_t size = 2;
+
+  while (size < (size_t) capacity) {
+    size <<= 1;
+  }
+
+  ring = malloc(sizeof(log_record_t) * size);
+
+  if (ring == null) {
+    logError("Failed to allocate async log ring");
+    return false;
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    atomic_init(&ring[i].sequence, i);
+  }
+
+  ringMask = size - 1;
+  atomic_store(&ringTail, 0);
+  atomic_store(&ringHead, 0);
+  atomic_store(&asyncRunning, 1);
+
+  if (pthread_create(&writerThread, null, writerMain, null) != 0) {
+    atomic_store(&asyncRunning, 0);
+    free(ring);
+    ring = null;
+
+    logError("Failed to start log writer thread");
+    return false;
+  }
+
+  if (!exitHookInstalled) {
+    atexit(onExit);
+    exitHookInstalled = true;
+  }
+
+  for (int i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+    previousHandlers[i] = signal(crashSignals[i], onCrash);
+  }
+
+  return true;
+}
+
+void cgaLogStopAsync() {
+  if (!atomic_exchange(&asyncRunning, 0)) {
+    return;
+  }
+
+  for (int i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+    signal(crashSignals[i], previousHandlers[i] == SIG_ERR ? SIG_DFL : previousHandlers[i]);
+  }
+
+  while (atomic_load(&activeProducers) > 0) {
+    cgaSleep(LOG_FLUSH_SLEEP);
   }
-}
\ No newline at end of file
+
+  pthread_mutex_lock(&writerLock);
+  pthread_cond_signal(&writerCond);
+  pthread_mutex_unlock(&writerLock);
+
+  // The writer drains everything published before it exits
+  pthread_join(writerThread, null);
+
+  free(ring);
+  ring = null;
+}
+
+void cgaLogFlush() {
+  if (!atomic_load(&asyncRunning)) {
+    fflush(stdout);
+    fflush(stderr);
+    return;
+  }
+
+  size_t target = atomic_load(&ringTail);
+
+  while (atomic_load(&ringHead) < target && atomic_load(&asyncRunning)) {
+    pthread_mutex_lock(&writerLock);
+    pthread_cond_signal(&writerCond);
+    pthread_mutex_unlock(&writerLock);
+
+    cgaSleep(LOG_FLUSH_SLEEP);
+  }
+}
+
+uint64_t cgaLogDropped() {
+  return atomic_load(&droppedRecords);
+}
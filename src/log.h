@@ -1,7 +1,12 @@
 #ifndef LOG_H_
 #define LOG_H_
 
+#include <stdint.h>
+#include "cga_core.h"
+
 #define DEBUG_ENABLED
+// Debug messages go to the binary log when one is open, see cga_binlog.h
+#define DEBUG_BINARY
 #define ERR_ENABLED
 #define INFO_ENABLED
 #define WARN_ENABLED
@@ -14,7 +19,11 @@
   #define logError(msg)
 #endif
 
-#ifdef DEBUG_ENABLED
+#if defined(DEBUG_ENABLED) && defined(DEBUG_BINARY)
+  #include "cga_binlog.h"
+  #define logDebugF(msg, ...) CGA_BINLOG(LL_DEBUG, msg, __VA_ARGS__)
+  #define logDebug(msg) CGA_BINLOG_0(LL_DEBUG, msg)
+#elif defined(DEBUG_ENABLED)
   #define logDebugF(msg, ...) cgaLog(LL_DEBUG, msg, __VA_ARGS__)
   #define logDebug(msg) cgaLog(LL_DEBUG, msg)
 #else
@@ -47,4 +56,21 @@ typedef enum {
 
 void cgaLog(log_level_t level, char* format, ...);
 
+// Async mode
+//
+// cgaLog still formats the message on the calling thread, then copies it
+// into a lock-free ring of `capacity` records (rounded up to a power of
+// two) and returns. A writer thread adds the timestamp and prints the
+// records in batches. Messages are dropped and counted when the ring is
+// full. The ring is flushed by cgaLogStopAsync, at exit, and on a best
+// effort basis when the process crashes on a fatal signal.
+boolean cgaLogStartAsync(int capacity);
+
+void cgaLogStopAsync();
+
+// Waits until everything logged so far has been written
+void cgaLogFlush();
+
+uint64_t cgaLogDropped();
+
 #endif // LOG_H_
\ No newline at end of file
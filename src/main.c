@@ -1,6 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "game.h"
 
-int main() {
+static void printUsage() {
+  printf("usage: game [--bench FRAMES] [--size WxH] [--move-every N] [--dump DIR]\n");
+  printf("            [--golden DIR] [--dump-every N] [--legacy] [--visible]\n");
+  printf("            [--render-thread] [--solver DEPTH]\n");
+}
+
+static int runBenchmark(int argc, char** argv) {
+  game_bench_options_t options = {
+    .frames = 1000,
+    .width = 800,
+    .height = 800,
+    .moveInterval = 10,
+    .dumpInterval = 0
+  };
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : null;
+
+    if (strcmp(arg, "--legacy") == 0) {
+      options.legacy = true;
+    } else if (strcmp(arg, "--visible") == 0) {
+      options.visible = true;
+    } else if (strcmp(arg, "--render-thread") == 0) {
+      options.renderThread = true;
+    } else if (value == null) {
+      printUsage();
+      return 1;
+    } else if (strcmp(arg, "--bench") == 0) {
+      options.frames = atoi(value);
+      i++;
+    } else if (strcmp(arg, "--size") == 0) {
+      if (sscanf(value, "%ix%i", &options.width, &options.height) != 2) {
+        printUsage();
+        return 1;
+      }
+      i++;
+    } else if (strcmp(arg, "--move-every") == 0) {
+      options.moveInterval = atoi(value);
+      i++;
+    } else if (strcmp(arg, "--dump") == 0) {
+      options.dumpDir = value;
+      i++;
+    } else if (strcmp(arg, "--golden") == 0) {
+      options.goldenDir = value;
+      i++;
+    } else if (strcmp(arg, "--dump-every") == 0) {
+      options.dumpInterval = atoi(value);
+      i++;
+    } else if (strcmp(arg, "--solver") == 0) {
+      options.solverDepth = atoi(value);
+      i++;
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if ((options.dumpDir != null || options.goldenDir != null) && options.dumpInterval == 0) {
+    options.dumpInterval = 1;
+  }
+
+  if (options.frames < 1 || options.width < 1 || options.height < 1 || options.moveInterval < 1
+    || options.solverDepth < 0) {
+    printUsage();
+    return 1;
+  }
+
+  return gameBenchmark(&options);
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    return runBenchmark(argc, argv);
+  }
+
   gameMain();
   return 0;
-}
\ No newline at end of file
+}
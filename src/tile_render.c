@@ -0,0 +1,175 @@
+#include "tile_render.h"
+#include "cga_render.h"
+#include "cga_gl_state.h"
+#include "cga_shader.h"
+#include "cga_batch.h"
+#include "log.h"
+#include <stddef.h>
+#include <stdlib.h>
+
+#define LAYOUT_BINDING 0
+
+enum {
+  LOCATION_CELL,
+  LOCATION_EXPONENT,
+  LOCATION_ANIMATION
+};
+
+// std140 mirror of the TileLayout block
+typedef struct {
+  float originStep[4];
+  float size[4];
+  int32_t grid[4];
+} layout_block_t;
+
+// Each instance is a 4 vertex strip whose corners come from gl_VertexID,
+// so there is no per-vertex buffer at all
+static const char* tileVertexShader =
+  "#version 330 core\n"
+  "layout(location = 0) in uint aCell;\n"
+  "layout(location = 1) in uint aExponent;\n"
+  "layout(location = 2) in vec3 aAnimation;\n"
+  "layout(std140) uniform TileLayout {\n"
+  "  vec4 uOriginStep;\n"
+  "  vec4 uSize;\n"
+  "  ivec4 uGrid;\n"
+  "};\n"
+  "uniform vec4 uPalette[16];\n"
+  "flat out vec4 vColor;\n"
+  "void main() {\n"
+  "  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+  "  int cell = int(aCell);\n"
+  "  vec2 gridPos = vec2(cell / uGrid.x, cell % uGrid.x) + aAnimation.yz;\n"
+  "  vec2 center = uOriginStep.xy + gridPos * uOriginStep.zw + uSize.xy * 0.5;\n"
+  "  vec2 pos = center + (corner - 0.5) * uSize.xy * aAnimation.x;\n"
+  "  vColor = uPalette[min(int(aExponent), 15)];\n"
+  "  gl_Position = vec4(pos, 0.0, 1.0);\n"
+  "}\n";
+
+static const char* tileFragmentShader =
+  "#version 330 core\n"
+  "flat in vec4 vColor;\n"
+  "out vec4 fragColor;\n"
+  "void main() {\n"
+  "  fragColor = vColor;\n"
+  "}\n";
+
+static void setupInstanceAttributes() {
+  GLsizei stride = sizeof(tile_instance_t);
+
+  glEnableVertexAttribArray(LOCATION_CELL);
+  glVertexAttribIPointer(LOCATION_CELL, 1, GL_UNSIGNED_BYTE, stride, (void*) offsetof(tile_instance_t, cell));
+  glVertexAttribDivisor(LOCATION_CELL, 1);
+
+  glEnableVertexAttribArray(LOCATION_EXPONENT);
+  glVertexAttribIPointer(LOCATION_EXPONENT, 1, GL_UNSIGNED_BYTE, stride, (void*) offsetof(tile_instance_t, exponent));
+  glVertexAttribDivisor(LOCATION_EXPONENT, 1);
+
+  glEnableVertexAttribArray(LOCATION_ANIMATION);
+  glVertexAttribPointer(LOCATION_ANIMATION, 3, GL_FLOAT, GL_FALSE, stride, (void*) offsetof(tile_instance_t, scale));
+  glVertexAttribDivisor(LOCATION_ANIMATION, 1);
+}
+
+tile_renderer cgaTilesCreate(int maxTiles) {
+  if (!cgaIsCoreProfile() || maxTiles < 1) {
+    return null;
+  }
+
+  tile_renderer tiles = calloc(1, sizeof(tile_renderer_t));
+
+  if (tiles == null) {
+    logError("Failed to allocate tile renderer");
+    return null;
+  }
+
+  tiles->program = cgaCreateProgram(tileVertexShader, tileFragmentShader);
+
+  if (tiles->program == 0) {
+    logError("Failed to create tile shader");
+    free(tiles);
+    return null;
+  }
+
+  GLuint blockIndex = glGetUniformBlockIndex(tiles->program, "TileLayout");
+  glUniformBlockBinding(tiles->program, blockIndex, LAYOUT_BINDING);
+  tiles->paletteLocation = glGetUniformLocation(tiles->program, "uPalette");
+  tiles->capacity = maxTiles;
+
+  glGenVertexArrays(1, &tiles->vertexArray);
+  glGenBuffers(1, &tiles->instanceBuffer);
+  glGenBuffers(1, &tiles->layoutBuffer);
+
+  cgaGlBindVertexArray(tiles->vertexArray);
+  cgaGlBindBuffer(GL_ARRAY_BUFFER, tiles->instanceBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(tile_instance_t) * maxTiles, null, GL_STREAM_DRAW);
+  setupInstanceAttributes();
+
+  cgaGlBindBuffer(GL_UNIFORM_BUFFER, tiles->layoutBuffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(layout_block_t), null, GL_DYNAMIC_DRAW);
+
+  return tiles;
+}
+
+void cgaTilesFree(tile_renderer tiles) {
+  if (tiles == null) {
+    return;
+  }
+
+  cgaGlDeleteVertexArray(tiles->vertexArray);
+  cgaGlDeleteBuffer(tiles->instanceBuffer);
+  cgaGlDeleteBuffer(tiles->layoutBuffer);
+  cgaFreeProgram(tiles->program);
+  free(tiles);
+}
+
+void cgaTilesSetLayout(tile_renderer tiles, const tile_layout_t* layout) {
+  layout_block_t block = {
+    .originStep = {layout->originX, layout->originY, layout->stepX, layout->stepY},
+    .size = {layout->sizeX, layout->sizeY, 0, 0},
+    .grid = {layout->columnLength, 0, 0, 0}
+  };
+
+  cgaGlBindBuffer(GL_UNIFORM_BUFFER, tiles->layoutBuffer);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+}
+
+void cgaTilesSetPalette(tile_renderer tiles, const uint8_t (*colors)[3], int count) {
+  float palette[TILE_PALETTE_SIZE][4] = {0};
+
+  if (count > TILE_PALETTE_SIZE) {
+    count = TILE_PALETTE_SIZE;
+  }
+
+  for (int i = 0; i < count; i++) {
+    for (int c = 0; c < 3; c++) {
+      palette[i][c] = colors[i][c] / 255.0f;
+    }
+
+    palette[i][3] = 1.0f;
+  }
+
+  cgaGlUseProgram(tiles->program);
+  glUniform4fv(tiles->paletteLocation, TILE_PALETTE_SIZE, &palette[0][0]);
+}
+
+void cgaTilesDraw(tile_renderer tiles, const tile_instance_t* instances, int count) {
+  if (count > tiles->capacity) {
+    count = tiles->capacity;
+  }
+
+  if (count < 1) {
+    return;
+  }
+
+  cgaBatchFlush();
+
+  cgaGlBindBuffer(GL_ARRAY_BUFFER, tiles->instanceBuffer);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(tile_instance_t) * count, instances);
+
+  cgaGlUseProgram(tiles->program);
+  cgaGlBindBufferBase(GL_UNIFORM_BUFFER, LAYOUT_BINDING, tiles->layoutBuffer);
+  cgaGlBindVertexArray(tiles->vertexArray);
+  cgaGlSetEnabled(GL_BLEND, false);
+
+  cgaGlDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+}
@@ -0,0 +1,65 @@
+#ifndef TILE_RENDER_H
+#define TILE_RENDER_H
+
+#include <stdint.h>
+#include "cga_core.h"
+
+// Instanced tile renderer
+//
+// Draws a grid of coloured tiles with one instanced draw call. Needs a core
+// profile context (cgaIsCoreProfile), cgaTilesCreate returns null otherwise
+// and callers keep drawing tiles as batched quads.
+
+#define TILE_PALETTE_SIZE 16
+
+typedef struct TileInstance {
+  // Position in the grid, x * columnLength + y
+  uint8_t cell;
+  // Palette index
+  uint8_t exponent;
+  uint8_t padding[2];
+
+  // Animation, size relative to a full tile and a displacement in cells
+  float scale;
+  float offsetX;
+  float offsetY;
+} tile_instance_t;
+
+// Where the grid is drawn, in normalized device coordinates
+typedef struct TileLayout {
+  // Start corner of the tile in cell 0
+  float originX;
+  float originY;
+  // Distance between neighbouring cells
+  float stepX;
+  float stepY;
+  // Extent of one tile, smaller than the step to leave a gap
+  float sizeX;
+  float sizeY;
+  int columnLength;
+} tile_layout_t;
+
+typedef struct TileRenderer {
+  uint32_t program;
+  uint32_t vertexArray;
+  uint32_t instanceBuffer;
+  uint32_t layoutBuffer;
+  int paletteLocation;
+  int capacity;
+} tile_renderer_t;
+
+typedef tile_renderer_t* tile_renderer;
+
+tile_renderer cgaTilesCreate(int maxTiles);
+
+void cgaTilesFree(tile_renderer tiles);
+
+void cgaTilesSetLayout(tile_renderer tiles, const tile_layout_t* layout);
+
+// RGB colours by exponent, at most TILE_PALETTE_SIZE of them
+void cgaTilesSetPalette(tile_renderer tiles, const uint8_t (*colors)[3], int count);
+
+// Flushes the quad batch so earlier quads stay below, then draws the tiles
+void cgaTilesDraw(tile_renderer tiles, const tile_instance_t* instances, int count);
+
+#endif // TILE_RENDER_H
@@ -0,0 +1,506 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cga_binlog.h"
+#include "log.h"
+
+#define LINE_SIZE 1024
+#define SPEC_SIZE 32
+// Room left after flags and widths for "ll", the conversion and the null
+#define SPEC_LIMIT (SPEC_SIZE - 4)
+
+typedef struct {
+  const char* file;
+  const char* format;
+  int line;
+  int level;
+  boolean defined;
+} format_t;
+
+typedef struct {
+  double time;
+  // Offset of the record in the file, keeps same-time events in file order
+  size_t offset;
+} event_t;
+
+typedef struct {
+  binlog_arg_type_t type;
+  int width;
+  union {
+    int64_t i;
+    uint64_t u;
+    double d;
+  };
+  const char* s;
+  int length;
+} decoded_arg_t;
+
+typedef struct {
+  const uint8_t* data;
+  size_t size;
+  size_t pos;
+} reader_t;
+
+static const char* levelNames[] = {" INFO", "DEBUG", " WARN", "ERROR"};
+
+static boolean take(reader_t* r, void* dst, size_t size) {
+  if (r->pos + size > r->size) {
+    return false;
+  }
+
+  memcpy(dst, r->data + r->pos, size);
+  r->pos += size;
+  return true;
+}
+
+static const char* takeString(reader_t* r, int* length) {
+  uint16_t length16;
+
+  if (!take(r, &length16, sizeof(length16)) || r->pos + length16 > r->size) {
+    return null;
+  }
+
+  const char* str = (const char*) r->data + r->pos;
+  r->pos += length16;
+  *length = length16;
+  return str;
+}
+
+static uint8_t* readFile(const char* path, size_t* size) {
+  FILE* f = fopen(path, "rb");
+
+  if (f == null) {
+    return null;
+  }
+
+  fseek(f, 0, SEEK_END);
+  long length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  uint8_t* data = length > 0 ? malloc((size_t) length) : null;
+
+  if (data == null || fread(data, 1, (size_t) length, f) != (size_t) length) {
+    free(data);
+    fclose(f);
+    return null;
+  }
+
+  fclose(f);
+  *size = (size_t) length;
+  return data;
+}
+
+static char* copyString(const char* src, int length) {
+  char* str = malloc((size_t) length + 1);
+
+  if (str != null) {
+    memcpy(str, src, length);
+    str[length] = '\0';
+  }
+
+  return str;
+}
+
+static int compareEvents(const void* a, const void* b) {
+  const event_t* ea = a;
+  const event_t* eb = b;
+
+  if (ea->time != eb->time) {
+    return ea->time < eb->time ? -1 : 1;
+  }
+
+  return ea->offset < eb->offset ? -1 : (ea->offset > eb->offset);
+}
+
+static boolean readArgs(reader_t* r, decoded_arg_t* args, int count) {
+  for (int i = 0; i < count; i++) {
+    uint8_t type;
+    uint8_t width;
+
+    if (!take(r, &type, sizeof(type)) || !take(r, &width, sizeof(width))) {
+      return false;
+    }
+
+    args[i].type = type;
+    args[i].width = width;
+    args[i].s = null;
+
+    if (type == BINLOG_ARG_STRING) {
+      args[i].s = takeString(r, &args[i].length);
+
+      if (args[i].s == null) {
+        return false;
+      }
+    } else if (!take(r, &args[i].u, sizeof(uint64_t))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static long long argInt(const decoded_arg_t* arg) {
+  switch (arg->type) {
+    case BINLOG_ARG_DOUBLE:
+      return (long long) arg->d;
+    case BINLOG_ARG_STRING:
+      return 0;
+    default:
+      return (long long) arg->i;
+  }
+}
+
+static double argDouble(const decoded_arg_t* arg) {
+  switch (arg->type) {
+    case BINLOG_ARG_DOUBLE:
+      return arg->d;
+    case BINLOG_ARG_INT:
+      return (double) arg->i;
+    case BINLOG_ARG_STRING:
+      return 0;
+    default:
+      return (double) arg->u;
+  }
+}
+
+// Bytes printf would have read for an integer conversion, hh and h cut
+// the value further like they do in printf
+static int intWidth(const decoded_arg_t* arg, int modifierWidth) {
+  if (modifierWidth > 0) {
+    return modifierWidth;
+  }
+
+  boolean integer = arg->type == BINLOG_ARG_INT || arg->type == BINLOG_ARG_UINT;
+  return integer && arg->width > 0 && arg->width < 8 ? arg->width : 8;
+}
+
+static unsigned long long cutUnsigned(unsigned long long value, int bytes) {
+  return bytes >= 8 ? value : value & ((1ULL << (bytes * 8)) - 1);
+}
+
+static long long cutSigned(unsigned long long value, int bytes) {
+  if (bytes >= 8) {
+    return (long long) value;
+  }
+
+  unsigned long long sign = 1ULL << (bytes * 8 - 1);
+  return (long long) ((cutUnsigned(value, bytes) ^ sign) - sign);
+}
+
+// Re-runs the printf conversions of `format` over the recorded arguments.
+// Length modifiers are dropped, integers are printed as long long and
+// floats as double since that's how they were stored.
+static void render(char* out, size_t outSize, const char* format, const decoded_arg_t* args, int count) {
+  size_t used = 0;
+  int next = 0;
+
+#define APPEND(...) do { \
+    int n = snprintf(out + used, outSize - used, __VA_ARGS__); \
+    if (n > 0) used += (size_t) n < outSize - used ? (size_t) n : outSize - used - 1; \
+  } while (0)
+
+  for (const char* p = format; *p != '\0' && used + 1 < outSize; p++) {
+    if (*p != '%') {
+      out[used++] = *p;
+      continue;
+    }
+
+    if (p[1] == '%') {
+      out[used++] = '%';
+      p++;
+      continue;
+    }
+
+    char spec[SPEC_SIZE];
+    int specLength = 0;
+    spec[specLength++] = '%';
+    p++;
+
+    // Flags and widths share SPEC_LIMIT, whatever doesn't fit is skipped so
+    // the conversion and the argument order stay in step
+    while (*p != '\0' && strchr("-+ #0'", *p) != null) {
+      if (specLength < SPEC_LIMIT) {
+        spec[specLength++] = *p;
+      }
+
+      p++;
+    }
+
+    // Widths and precisions given as * take an argument of their own
+    while (*p != '\0' && strchr("0123456789.*", *p) != null) {
+      if (*p == '*') {
+        int value = next < count ? (int) argInt(&args[next++]) : 0;
+        int room = SPEC_LIMIT - specLength;
+        int written = room > 0 ? snprintf(spec + specLength, room + 1, "%i", value) : -1;
+
+        // A value that didn't fit whole is dropped rather than cut
+        if (written > 0 && written <= room) {
+          specLength += written;
+        }
+      } else if (specLength < SPEC_LIMIT) {
+        spec[specLength++] = *p;
+      }
+
+      p++;
+    }
+
+    // Conversions below always use ll, only h and hh change the value
+    int modifierWidth = 0;
+
+    while (*p != '\0' && strchr("hlLqjzt", *p) != null) {
+      modifierWidth = *p != 'h' ? 0 : (modifierWidth == 2 ? 1 : 2);
+      p++;
+    }
+
+    if (*p == '\0') {
+      break;
+    }
+
+    char conversion = *p;
+    const decoded_arg_t* arg = next < count ? &args[next++] : null;
+
+    if (arg == null) {
+      APPEND("<missing>");
+      continue;
+    }
+
+    switch (conversion) {
+      case 'd':
+      case 'i':
+        spec[specLength++] = 'l';
+        spec[specLength++] = 'l';
+        spec[specLength++] = conversion;
+        spec[specLength] = '\0';
+        APPEND(spec, cutSigned((unsigned long long) argInt(arg), intWidth(arg, modifierWidth)));
+        break;
+
+      case 'u':
+      case 'o':
+      case 'x':
+      case 'X':
+        spec[specLength++] = 'l';
+        spec[specLength++] = 'l';
+        spec[specLength++] = conversion;
+        spec[specLength] = '\0';
+        APPEND(spec, cutUnsigned((unsigned long long) argInt(arg), intWidth(arg, modifierWidth)));
+        break;
+
+      case 'c':
+        spec[specLength++] = 'c';
+        spec[specLength] = '\0';
+        APPEND(spec, (int) argInt(arg));
+        break;
+
+      case 'f':
+      case 'F':
+      case 'e':
+      case 'E':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A':
+        spec[specLength++] = conversion;
+        spec[specLength] = '\0';
+        APPEND(spec, argDouble(arg));
+        break;
+
+      case 's':
+        if (arg->type == BINLOG_ARG_STRING) {
+          // The stored copy isn't terminated
+          char str[BINLOG_MAX_STRING + 1];
+          memcpy(str, arg->s, arg->length);
+          str[arg->length] = '\0';
+
+          spec[specLength++] = 's';
+          spec[specLength] = '\0';
+          APPEND(spec, str);
+        } else {
+          APPEND("0x%llx", (unsigned long long) arg->u);
+        }
+        break;
+
+      case 'p':
+        APPEND("0x%llx", (unsigned long long) arg->u);
+        break;
+
+      default:
+        APPEND("<%%%c>", conversion);
+        break;
+    }
+  }
+
+#undef APPEND
+
+  out[used < outSize ? used : outSize - 1] = '\0';
+}
+
+static void printEvent(const binlog_header_t* header, const format_t* format, double seconds, const char* message) {
+  time_t wall = (time_t) header->startTime + (time_t) seconds;
+  int millis = (int) ((seconds - (long long) seconds) * 1000);
+  struct tm* local = localtime(&wall);
+  char timeText[16] = "??:??:??";
+
+  if (local != null) {
+    strftime(timeText, sizeof(timeText), "%H:%M:%S", local);
+  }
+
+  const char* level = format->level >= 0 && format->level <= LL_ERROR ? levelNames[format->level] : "  ???";
+  printf("[%s.%03i %s] %s\n", timeText, millis, level, message);
+}
+
+// Usage: log_decode <file> [--sites]
+// Renders a binary log written through cgaBinLogOpen as text, ordered by
+// time. --sites appends the file and line of every message.
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("Usage: %s <binary log> [--sites]\n", argv[0]);
+    return 1;
+  }
+
+  boolean sites = argc > 2 && strcmp(argv[2], "--sites") == 0;
+  size_t size = 0;
+  uint8_t* data = readFile(argv[1], &size);
+
+  if (data == null) {
+    printf("[ERROR] Failed to read '%s'\n", argv[1]);
+    return 1;
+  }
+
+  reader_t r = {data, size, 0};
+  binlog_header_t header;
+
+  if (!take(&r, &header, sizeof(header)) || header.magic != BINLOG_MAGIC || header.version != BINLOG_VERSION) {
+    printf("[ERROR] '%s' isn't a version %i binary log\n", argv[1], BINLOG_VERSION);
+    free(data);
+    return 1;
+  }
+
+  format_t* formats = calloc(UINT16_MAX + 1, sizeof(format_t));
+  size_t eventCapacity = 1024;
+  size_t eventCount = 0;
+  event_t* events = malloc(sizeof(event_t) * eventCapacity);
+  boolean truncated = false;
+
+  if (formats == null || events == null) {
+    printf("[ERROR] Out of memory\n");
+    return 1;
+  }
+
+  // First pass collects the formats and where each event starts
+  while (r.pos < r.size) {
+    size_t offset = r.pos;
+    uint8_t type;
+    uint16_t id;
+
+    take(&r, &type, sizeof(type));
+
+    if (type == BINLOG_RECORD_FORMAT) {
+      uint8_t level;
+      uint32_t line;
+      int fileLength;
+      int formatLength;
+
+      if (!take(&r, &id, sizeof(id)) || !take(&r, &level, sizeof(level)) || !take(&r, &line, sizeof(line))) {
+        truncated = true;
+        break;
+      }
+
+      const char* file = takeString(&r, &fileLength);
+      const char* format = file != null ? takeString(&r, &formatLength) : null;
+
+      if (format == null) {
+        truncated = true;
+        break;
+      }
+
+      format_t* f = &formats[id];
+      free((void*) f->file);
+      free((void*) f->format);
+      f->file = copyString(file, fileLength);
+      f->format = copyString(format, formatLength);
+      f->line = (int) line;
+      f->level = level;
+      f->defined = true;
+    } else if (type == BINLOG_RECORD_EVENT) {
+      uint8_t argCount;
+      double seconds;
+      decoded_arg_t args[BINLOG_MAX_ARGS];
+
+      if (!take(&r, &id, sizeof(id)) || !take(&r, &argCount, sizeof(argCount))
+        || !take(&r, &seconds, sizeof(seconds)) || argCount > BINLOG_MAX_ARGS
+        || !readArgs(&r, args, argCount)) {
+        truncated = true;
+        break;
+      }
+
+      if (eventCount == eventCapacity) {
+        eventCapacity *= 2;
+        event_t* nptr = realloc(events, sizeof(event_t) * eventCapacity);
+
+        if (nptr == null) {
+          printf("[ERROR] Out of memory\n");
+          return 1;
+        }
+
+        events = nptr;
+      }
+
+      events[eventCount++] = (event_t) {seconds, offset};
+    } else {
+      printf("[ERROR] Unknown record type %i at offset %zu\n", type, offset);
+      truncated = true;
+      break;
+    }
+  }
+
+  // Threads write their buffers in chunks, so file order isn't time order
+  qsort(events, eventCount, sizeof(event_t), compareEvents);
+
+  char message[LINE_SIZE];
+
+  for (size_t i = 0; i < eventCount; i++) {
+    reader_t er = {data, size, events[i].offset + 1};
+    uint16_t id;
+    uint8_t argCount;
+    double seconds;
+    decoded_arg_t args[BINLOG_MAX_ARGS];
+
+    take(&er, &id, sizeof(id));
+    take(&er, &argCount, sizeof(argCount));
+    take(&er, &seconds, sizeof(seconds));
+    readArgs(&er, args, argCount);
+
+    const format_t* format = &formats[id];
+
+    if (!format->defined || format->format == null) {
+      printf("[ERROR] Event at offset %zu uses undefined format %i\n", events[i].offset, id);
+      continue;
+    }
+
+    render(message, sizeof(message), format->format, args, argCount);
+
+    if (sites) {
+      size_t length = strlen(message);
+      snprintf(message + length, sizeof(message) - length, "  (%s:%i)", format->file, format->line);
+    }
+
+    printEvent(&header, format, seconds, message);
+  }
+
+  if (truncated) {
+    printf("[ WARN] Log is truncated or corrupt after %zu events\n", eventCount);
+  }
+
+  for (int i = 0; i <= UINT16_MAX; i++) {
+    free((void*) formats[i].file);
+    free((void*) formats[i].format);
+  }
+
+  free(formats);
+  free(events);
+  free(data);
+
+  return truncated ? 1 : 0;
+}
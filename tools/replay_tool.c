@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "game_rules.h"
+#include "game_replay.h"
+
+static double now() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void printBoard(game_context game) {
+  for (int y = 0; y < BOARD_HEIGHT; y++) {
+    // x = 0 is drawn on the right side of the screen
+    for (int x = BOARD_WIDTH - 1; x >= 0; x--) {
+      printf("%6i", gameGetCell(game, x, y));
+    }
+
+    printf("\n");
+  }
+}
+
+// Re-simulates the whole replay from its seed and checks every checkpoint
+static boolean verify(replay_reader reader, game_context game) {
+  const replay_header_t* header = reader->header;
+  uint64_t moveCount = header->moveCount;
+  uint32_t nextCheckpoint = 1;
+
+  gameResetSeeded(game, header->seed);
+
+  for (uint64_t t = 0; t < moveCount; t++) {
+    if (!gameMove(game, replayGetMove(reader, t))) {
+      printf("[ERROR] Move %llu doesn't change the board\n", (unsigned long long) t);
+      return false;
+    }
+
+    if (nextCheckpoint >= header->checkpointCount) {
+      continue;
+    }
+
+    const replay_checkpoint_t* cp = &reader->checkpoints[nextCheckpoint];
+
+    if (cp->turn != t + 1) {
+      continue;
+    }
+
+    if (cp->board != gameGetBoard(game) || cp->score != (uint64_t) gameGetScore(game)) {
+      printf("[ERROR] Checkpoint at turn %llu doesn't match\n", (unsigned long long) cp->turn);
+      return false;
+    }
+
+    nextCheckpoint++;
+  }
+
+  return true;
+}
+
+// Usage: replay_tool <file> [turn]
+// Re-simulates a replay headlessly, then optionally seeks to a turn and
+// prints the board
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("Usage: %s <replay file> [turn]\n", argv[0]);
+    return 1;
+  }
+
+  replay_reader reader = replayOpen(argv[1]);
+
+  if (reader == NULL) {
+    printf("[ERROR] Failed to open replay '%s'\n", argv[1]);
+    return 1;
+  }
+
+  game_context game = gameCreateSeeded(replayGetSeed(reader));
+
+  if (game == NULL) {
+    replayClose(reader);
+    return 1;
+  }
+
+  uint64_t moveCount = replayGetMoveCount(reader);
+
+  printf("seed=%llu moves=%llu checkpoints=%u\n",
+    (unsigned long long) replayGetSeed(reader),
+    (unsigned long long) moveCount,
+    reader->header->checkpointCount
+  );
+
+  double start = now();
+  boolean ok = verify(reader, game);
+  double elapsed = now() - start;
+
+  printf("re-simulated in %.4fs (%.0f moves/sec), score=%i lost=%i\n",
+    elapsed,
+    elapsed > 0 ? moveCount / elapsed : 0.0,
+    gameGetScore(game),
+    gameIsLost(game)
+  );
+
+  if (ok && argc > 2) {
+    uint64_t turn = strtoull(argv[2], NULL, 10);
+
+    start = now();
+    ok = replaySeek(reader, game, turn);
+    elapsed = now() - start;
+
+    if (ok) {
+      printf("turn %llu (seek %.6fs), score=%i\n", (unsigned long long) turn, elapsed, gameGetScore(game));
+      printBoard(game);
+    } else {
+      printf("[ERROR] Failed to seek to turn %llu\n", (unsigned long long) turn);
+    }
+  }
+
+  gameFree(game);
+  replayClose(reader);
+
+  return ok ? 0 : 1;
+}